@@ -1,7 +1,13 @@
 // ElegantLog.hpp
 #pragma once
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <cerrno>
 #include <iostream>
 #include <atomic>
 #include <chrono>
@@ -17,8 +23,13 @@
 #include <thread>
 #include <vector>
 #include <iomanip>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
 #include <condition_variable>
+#include <algorithm>
 
 namespace ElegantLog
 {
@@ -67,59 +78,496 @@ namespace ElegantLog
         FATAL
     };
 
-    inline const std::string levelToString(LogLevel level)
+    inline const char *levelName(LogLevel level)
     {
         static const char *levels[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
         auto index = static_cast<size_t>(level);
         return (index < sizeof(levels) / sizeof(levels[0])) ? levels[index] : "UNKNOWN";
     }
 
+    inline const std::string levelToString(LogLevel level)
+    {
+        return levelName(level);
+    }
+
     // ==================== 格式化工具 ====================
+    // LOG_* 的格式串在编译期切分：占位符个数和参数个数对不上直接编译报错，
+    // 每个 "{}" 的位置算好存在调用点的静态 FormatSpec 里，运行时只做追加
     namespace detail
     {
-        // 结束递归
-        inline void formatHelper(std::ostringstream &oss, const std::string &fmt, size_t pos = 0)
+        template <size_t... I>
+        struct index_sequence
+        {
+        };
+        template <size_t N, size_t... I>
+        struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...>
+        {
+        };
+        template <size_t... I>
+        struct make_index_sequence<0, I...> : index_sequence<I...>
+        {
+        };
+
+        constexpr size_t literalLength(const char *s, size_t n = 0)
+        {
+            return s[n] == '\0' ? n : literalLength(s, n + 1);
+        }
+
+        constexpr size_t countPlaceholders(const char *s)
+        {
+            return *s == '\0' ? 0 : (s[0] == '{' && s[1] == '}') ? 1 + countPlaceholders(s + 2) : countPlaceholders(s + 1);
+        }
+
+        // 第 n 个 "{}" 的偏移
+        constexpr size_t placeholderAt(const char *s, size_t n, size_t pos = 0)
+        {
+            return (s[pos] == '{' && s[pos + 1] == '}') ? (n == 0 ? pos : placeholderAt(s, n - 1, pos + 2))
+                                                        : placeholderAt(s, n, pos + 1);
+        }
+
+        // 只在 decltype 里用，参数不会被求值
+        template <typename... Args>
+        std::integral_constant<size_t, sizeof...(Args)> argCount(const Args &...);
+
+        template <size_t N>
+        struct FormatSpec
+        {
+            const char *fmt;
+            size_t len;
+            size_t pos[N + 1]; // 多一个，N 为 0 时也不是空数组
+
+            constexpr FormatSpec(const char *s) : FormatSpec(s, make_index_sequence<N>()) {}
+
+            template <size_t... I>
+            constexpr FormatSpec(const char *s, index_sequence<I...>)
+                : fmt(s), len(literalLength(s)), pos{placeholderAt(s, I)..., 0} {}
+        };
+
+        // ---------- 参数追加，输出和 ostream 默认格式一致 ----------
+        template <typename U>
+        void appendUnsigned(std::string &out, U v)
         {
-            oss << fmt.substr(pos);
+            char buf[24];
+            char *p = buf + sizeof(buf);
+            do
+            {
+                *--p = static_cast<char>('0' + v % 10);
+                v /= 10;
+            } while (v);
+            out.append(p, buf + sizeof(buf) - p);
         }
 
-        // 单参数版本
         template <typename T>
-        void formatHelper(std::ostringstream &oss, const std::string &fmt, size_t pos, T &&arg)
+        void appendInteger(std::string &out, T v, std::true_type /* signed */)
         {
-            size_t next_pos = fmt.find("{}", pos);
-            if (next_pos == std::string::npos)
+            typedef typename std::make_unsigned<T>::type U;
+            if (v < 0)
             {
-                oss << fmt.substr(pos); // 只输出剩余部分
-                return;
+                out.push_back('-');
+                appendUnsigned(out, static_cast<U>(U(0) - static_cast<U>(v)));
             }
-            oss << fmt.substr(pos, next_pos - pos);
-            oss << std::forward<T>(arg);
-            formatHelper(oss, fmt, next_pos + 2);
+            else
+                appendUnsigned(out, static_cast<U>(v));
+        }
+        template <typename T>
+        void appendInteger(std::string &out, T v, std::false_type)
+        {
+            appendUnsigned(out, v);
+        }
+
+        template <typename T>
+        void appendValue(std::string &out, const T &v, std::true_type /* integral */, std::false_type)
+        {
+            appendInteger(out, v, std::is_signed<T>());
+        }
+        template <typename T>
+        void appendValue(std::string &out, const T &v, std::false_type, std::true_type /* floating */)
+        {
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+            out.append(buf, n > 0 ? static_cast<size_t>(n) : 0);
+        }
+        // 其他类型（枚举、atomic、自定义 operator<<）走 ostream
+        template <typename T>
+        void appendValue(std::string &out, const T &v, std::false_type, std::false_type)
+        {
+            std::ostringstream oss;
+            oss << v;
+            out += oss.str();
+        }
+
+        template <typename T>
+        void appendArg(std::string &out, const T &v)
+        {
+            appendValue(out, v, std::is_integral<T>(), std::is_floating_point<T>());
+        }
+        inline void appendArg(std::string &out, const std::string &v) { out += v; }
+        inline void appendArg(std::string &out, const char *v) { out += v ? v : "(null)"; }
+        inline void appendArg(std::string &out, char *v) { appendArg(out, static_cast<const char *>(v)); }
+        inline void appendArg(std::string &out, char v) { out.push_back(v); }
+        inline void appendArg(std::string &out, signed char v) { out.push_back(static_cast<char>(v)); }
+        inline void appendArg(std::string &out, unsigned char v) { out.push_back(static_cast<char>(v)); }
+        inline void appendArg(std::string &out, bool v) { out.push_back(v ? '1' : '0'); }
+        template <size_t N>
+        void appendArg(std::string &out, const char (&v)[N]) { out += v; }
+
+        // ---------- 按编译期切好的段追加 ----------
+        template <size_t N, size_t I>
+        void formatSegments(std::string &out, const FormatSpec<N> &spec)
+        {
+            size_t from = I == 0 ? 0 : spec.pos[I - 1] + 2;
+            out.append(spec.fmt + from, spec.len - from);
+        }
+
+        template <size_t N, size_t I, typename T, typename... Args>
+        void formatSegments(std::string &out, const FormatSpec<N> &spec, const T &arg, const Args &...args)
+        {
+            size_t from = I == 0 ? 0 : spec.pos[I - 1] + 2;
+            out.append(spec.fmt + from, spec.pos[I] - from);
+            appendArg(out, arg);
+            formatSegments<N, I + 1>(out, spec, args...);
+        }
+
+        template <size_t N, typename... Args>
+        void formatTo(std::string &out, const FormatSpec<N> &spec, const Args &...args)
+        {
+            static_assert(N == sizeof...(Args), "format: number of {} does not match number of arguments");
+            formatSegments<N, 0>(out, spec, args...);
+        }
+
+        // ---------- 运行时格式串（非字面量），多余的参数丢弃 ----------
+        inline void formatRuntime(std::string &out, const char *fmt)
+        {
+            out += fmt;
         }
 
-        // 多参数版本
         template <typename T, typename... Args>
-        void formatHelper(std::ostringstream &oss, const std::string &fmt, size_t pos, T &&arg, Args &&...args)
+        void formatRuntime(std::string &out, const char *fmt, const T &arg, const Args &...args)
         {
-            size_t next_pos = fmt.find("{}", pos);
-            if (next_pos == std::string::npos)
+            const char *p = strstr(fmt, "{}");
+            if (!p)
             {
-                oss << fmt.substr(pos);
+                out += fmt;
                 return;
             }
-            oss << fmt.substr(pos, next_pos - pos);
-            oss << std::forward<T>(arg);
-            formatHelper(oss, fmt, next_pos + 2, std::forward<Args>(args)...);
+            out.append(fmt, p - fmt);
+            appendArg(out, arg);
+            formatRuntime(out, p + 2, args...);
         }
     }
 
     template <typename... Args>
     std::string format(const std::string &fmt, Args &&...args)
     {
-        std::ostringstream oss;
-        detail::formatHelper(oss, fmt, 0, std::forward<Args>(args)...);
-        return oss.str();
+        std::string out;
+        out.reserve(fmt.size() + 16 * sizeof...(Args));
+        detail::formatRuntime(out, fmt.c_str(), args...);
+        return out;
+    }
+
+    // ==================== 日志记录和二进制模式 ====================
+    // 定长日志记录，直接放在环形队列的槽里，入队不分配内存；超长的消息截断。
+    // TEXT 记录里是格式化好的文本；BINARY 记录只有调用点编号、时间戳和原始参数，
+    // 格式化推迟到后台线程（给文本 sink）或离线解码工具 test/log_decode.cpp
+    inline int64_t wallClockNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // 调用点只取单调时钟（CLOCK_MONOTONIC，走 vDSO 不进内核），不受 NTP 调时影响，
+    // 两条日志的时间相减就是真实间隔，可以直接量串口事务、发布的耗时
+    inline int64_t monotonicNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /**
+     * @brief 后台把记录里的单调时间换成墙上时间
+     * 偏移量 = system_clock - steady_clock，每秒重新校准一次，跟上 NTP 调时。
+     * 不加锁，由调用方（Logger::writeRecord）保证单线程使用
+     */
+    class WallClock
+    {
+    public:
+        int64_t toWall(int64_t mono)
+        {
+            int64_t now = monotonicNs();
+            if (m_calibrated == 0 || now - m_calibrated >= RECALIBRATE_NS)
+                calibrate();
+            return mono + m_offset;
+        }
+
+    private:
+        static const int64_t RECALIBRATE_NS = 1000000000;
+
+        // 墙上时间夹在两次单调时间中间读，取中点
+        void calibrate()
+        {
+            int64_t before = monotonicNs();
+            int64_t wall = wallClockNs();
+            int64_t after = monotonicNs();
+            m_offset = wall - (before + (after - before) / 2);
+            m_calibrated = after;
+        }
+
+        int64_t m_offset = 0;
+        int64_t m_calibrated = 0;
+    };
+
+    struct LogRecord
+    {
+        static const size_t TEXT_SIZE = 480;
+        enum Kind : uint8_t
+        {
+            TEXT,
+            BINARY
+        };
+
+        LogLevel level;
+        Kind kind;
+        uint16_t len;
+        uint32_t site; // BINARY：调用点编号
+        int64_t time;  // 调用时刻，单调时钟纳秒（monotonicNs），后台按它归并各线程的记录，写出时才换成墙上时间
+        char text[TEXT_SIZE];
+    };
+
+    // 一个 LOG_* 调用点的静态描述，二进制模式下每个调用点只登记一次
+    struct LogSite
+    {
+        LogLevel level;
+        const char *location;
+        const char *func;
+        const char *fmt;
+    };
+
+    class SiteRegistry
+    {
+    public:
+        static SiteRegistry &instance()
+        {
+            static SiteRegistry registry;
+            return registry;
+        }
+
+        uint32_t add(const LogSite &site)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_sites.push_back(site);
+            return static_cast<uint32_t>(m_sites.size() - 1);
+        }
+
+        bool get(uint32_t id, LogSite &out)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (id >= m_sites.size())
+                return false;
+            out = m_sites[id];
+            return true;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<LogSite> m_sites;
+    };
+
+    inline uint32_t registerSite(LogLevel level, const char *location, const char *func, const char *fmt)
+    {
+        LogSite site = {level, location, func, fmt};
+        return SiteRegistry::instance().add(site);
+    }
+
+    /**
+     * 二进制日志文件格式（主机字节序，板子和 PC 都是小端）：
+     *   文件头  "ELOG" + 版本(u8)
+     *   'S' 调用点  id(u32) level(u8) location(u16 长度+字节) func(同) fmt(同)，文件里第一次用到时写
+     *   'R' 记录    id(u32) time(i64 纳秒) len(u16) 参数
+     *   'T' 文本    level(u8) time(i64 纳秒) len(u16) 文本
+     * 参数逐个编码：tag(u8) + 值；整数 8 字节，浮点 double，字符串 u16 长度 + 字节
+     */
+    namespace binary
+    {
+        const char MAGIC[4] = {'E', 'L', 'O', 'G'};
+        const uint8_t VERSION = 1;
+
+        enum ArgTag : uint8_t
+        {
+            ARG_INT = 1,
+            ARG_UINT,
+            ARG_FLOAT,
+            ARG_STRING,
+            ARG_CHAR
+        };
+    }
+
+    namespace detail
+    {
+        // 直接往队列槽里写参数。第一个写不下的参数和它后面的都丢掉：
+        // end 收到 p，p 停在最后一个完整参数之后，记录长度不会把槽里上一条记录的残留算进来
+        struct ArgWriter
+        {
+            char *p;
+            char *end;
+
+            template <typename T>
+            void put(uint8_t tag, T v)
+            {
+                if (static_cast<size_t>(end - p) < 1 + sizeof(v))
+                {
+                    end = p;
+                    return;
+                }
+                *p++ = static_cast<char>(tag);
+                memcpy(p, &v, sizeof(v));
+                p += sizeof(v);
+            }
+
+            void putString(const char *s, size_t n)
+            {
+                if (end - p < 3)
+                {
+                    end = p;
+                    return;
+                }
+                n = std::min(n, static_cast<size_t>(end - p - 3));
+                uint16_t len = static_cast<uint16_t>(n);
+                *p++ = static_cast<char>(binary::ARG_STRING);
+                memcpy(p, &len, sizeof(len));
+                p += sizeof(len);
+                memcpy(p, s, n);
+                p += n;
+            }
+        };
+
+        template <typename T>
+        void encodeValue(ArgWriter &w, const T &v, std::true_type /* integral */, std::false_type)
+        {
+            if (std::is_signed<T>::value)
+                w.put(binary::ARG_INT, static_cast<int64_t>(v));
+            else
+                w.put(binary::ARG_UINT, static_cast<uint64_t>(v));
+        }
+        template <typename T>
+        void encodeValue(ArgWriter &w, const T &v, std::false_type, std::true_type /* floating */)
+        {
+            w.put(binary::ARG_FLOAT, static_cast<double>(v));
+        }
+        // 其他类型在调用点转成文本
+        template <typename T>
+        void encodeValue(ArgWriter &w, const T &v, std::false_type, std::false_type)
+        {
+            std::string text;
+            appendArg(text, v);
+            w.putString(text.data(), text.size());
+        }
+
+        template <typename T>
+        void encodeArg(ArgWriter &w, const T &v)
+        {
+            encodeValue(w, v, std::is_integral<T>(), std::is_floating_point<T>());
+        }
+        inline void encodeArg(ArgWriter &w, const std::string &v) { w.putString(v.data(), v.size()); }
+        inline void encodeArg(ArgWriter &w, const char *v)
+        {
+            if (!v)
+                v = "(null)";
+            w.putString(v, strlen(v));
+        }
+        inline void encodeArg(ArgWriter &w, char *v) { encodeArg(w, static_cast<const char *>(v)); }
+        inline void encodeArg(ArgWriter &w, char v) { w.put(binary::ARG_CHAR, v); }
+        inline void encodeArg(ArgWriter &w, signed char v) { w.put(binary::ARG_CHAR, static_cast<char>(v)); }
+        inline void encodeArg(ArgWriter &w, unsigned char v) { w.put(binary::ARG_CHAR, static_cast<char>(v)); }
+        inline void encodeArg(ArgWriter &w, bool v) { w.put(binary::ARG_UINT, static_cast<uint64_t>(v)); }
+        template <size_t N>
+        void encodeArg(ArgWriter &w, const char (&v)[N]) { w.putString(v, strlen(v)); }
+
+        inline void encodeArgs(ArgWriter &)
+        {
+        }
+        template <typename T, typename... Args>
+        void encodeArgs(ArgWriter &w, const T &arg, const Args &...args)
+        {
+            encodeArg(w, arg);
+            encodeArgs(w, args...);
+        }
+
+        // 解出一个参数追加到 out，数据不完整时返回 false
+        inline bool decodeArg(std::string &out, const char *&p, const char *end)
+        {
+            if (p >= end)
+                return false;
+            uint8_t tag = static_cast<uint8_t>(*p++);
+            switch (tag)
+            {
+            case binary::ARG_INT:
+            case binary::ARG_UINT:
+            case binary::ARG_FLOAT:
+            {
+                if (end - p < 8)
+                    return false;
+                if (tag == binary::ARG_INT)
+                {
+                    int64_t v;
+                    memcpy(&v, p, 8);
+                    appendArg(out, v);
+                }
+                else if (tag == binary::ARG_UINT)
+                {
+                    uint64_t v;
+                    memcpy(&v, p, 8);
+                    appendArg(out, v);
+                }
+                else
+                {
+                    double v;
+                    memcpy(&v, p, 8);
+                    appendArg(out, v);
+                }
+                p += 8;
+                return true;
+            }
+            case binary::ARG_CHAR:
+                if (end - p < 1)
+                    return false;
+                out.push_back(*p++);
+                return true;
+            case binary::ARG_STRING:
+            {
+                uint16_t len;
+                if (end - p < 2)
+                    return false;
+                memcpy(&len, p, 2);
+                p += 2;
+                if (end - p < len)
+                    return false;
+                out.append(p, len);
+                p += len;
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+    }
+
+    // 按格式串把编码好的参数还原成文本，缺的参数保留 "{}"
+    inline void formatEncoded(std::string &out, const char *fmt, const char *args, size_t len)
+    {
+        const char *end = args + len;
+        while (const char *p = strstr(fmt, "{}"))
+        {
+            out.append(fmt, p - fmt);
+            if (!detail::decodeArg(out, args, end))
+            {
+                out += "{}";
+                args = end;
+            }
+            fmt = p + 2;
+        }
+        out += fmt;
     }
 
     // ==================== 日志输出目标 ====================
@@ -129,6 +577,16 @@ namespace ElegantLog
         virtual ~Sink() = default;
         virtual void log(LogLevel level, const std::string &message) = 0;
         virtual void flush() = 0;
+
+        // 带调用时刻（墙上时间，纳秒）的版本，Logger 走这里；不打时间戳的 sink 不用管
+        virtual void logTimed(LogLevel level, const std::string &message, int64_t /*wall_ns*/)
+        {
+            log(level, message);
+        }
+
+        // 二进制 sink 直接收队列里的原始记录，不需要后台线程替它格式化
+        virtual bool binary() const { return false; }
+        virtual void logRecord(const LogRecord &, int64_t /*wall_ns*/) {}
     };
 
     class ConsoleSink : public Sink
@@ -173,210 +631,1029 @@ namespace ElegantLog
             }
         }
 
-        std::mutex m_mutex;
-        bool m_use_color;
+        std::mutex m_mutex;
+        bool m_use_color;
+    };
+
+    /**
+     * @brief 后台归档线程：把轮转下来的日志文件排好序号（app.log.1 最新）并用 gzip 压缩
+     * 线程优先级调到最低（nice 19），压缩不和串口、MQTT 线程抢 CPU。
+     * 没有 gzip 或压缩失败时保留未压缩的文件
+     */
+    class LogArchiver
+    {
+    public:
+        LogArchiver(const std::string &base_filename, uint8_t max_files, bool compress)
+            : m_base_filename(base_filename), m_max_files(max_files), m_compress(compress)
+        {
+            m_worker = std::thread([this]
+                                   { run(); });
+        }
+
+        // 已经交过来的文件处理完再退出
+        ~LogArchiver()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = false;
+            }
+            m_cv.notify_one();
+            m_worker.join();
+        }
+
+        void submit(const std::string &pending)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs.push_back(pending);
+            }
+            m_cv.notify_one();
+        }
+
+    private:
+        void run()
+        {
+            setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+            while (true)
+            {
+                std::string pending;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_cv.wait(lock, [this]
+                              { return !m_jobs.empty() || !m_running; });
+                    if (m_jobs.empty())
+                        return;
+                    pending = m_jobs.front();
+                    m_jobs.erase(m_jobs.begin());
+                }
+                archive(pending);
+            }
+        }
+
+        std::string segment(int i) const
+        {
+            return m_base_filename + "." + std::to_string(i);
+        }
+
+        static bool exists(const std::string &name)
+        {
+            struct stat st;
+            return stat(name.c_str(), &st) == 0;
+        }
+
+        void archive(const std::string &pending)
+        {
+            if (m_max_files == 0)
+            {
+                std::remove(pending.c_str());
+                return;
+            }
+            // 最旧的一份删掉，其余往后挪 (app.log.1[.gz] → app.log.2[.gz], etc.)
+            std::remove(segment(m_max_files).c_str());
+            std::remove((segment(m_max_files) + ".gz").c_str());
+            for (int i = m_max_files - 1; i > 0; --i)
+            {
+                std::string gz = segment(i) + ".gz";
+                if (exists(gz))
+                    std::rename(gz.c_str(), (segment(i + 1) + ".gz").c_str());
+                else
+                    std::rename(segment(i).c_str(), segment(i + 1).c_str());
+            }
+            std::rename(pending.c_str(), segment(1).c_str());
+            if (m_compress)
+                gzip(segment(1));
+        }
+
+        // gzip -f file → file.gz，成功后 gzip 自己删掉原文件
+        static bool gzip(const std::string &path)
+        {
+            std::vector<char> arg(path.begin(), path.end());
+            arg.push_back('\0');
+            char gzip_name[] = "gzip";
+            char force[] = "-f";
+            char *argv[] = {gzip_name, force, arg.data(), nullptr};
+            pid_t pid;
+            if (posix_spawnp(&pid, "gzip", nullptr, nullptr, argv, environ) != 0)
+                return false;
+            int status = 0;
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+            {
+            }
+            return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+
+        std::string m_base_filename;
+        const uint8_t m_max_files;
+        const bool m_compress;
+        std::vector<std::string> m_jobs;
+        bool m_running = true;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::thread m_worker;
+    };
+
+    /**
+     * @brief 文本日志文件
+     * 每行先追加到一块预分配的大缓冲区，满了（或后台线程空闲、超过 flush_interval）才一次 write()；
+     * 时间戳只在秒变化时重新格式化。文件用 O_APPEND 打开。
+     * 按大小或时间轮转：写日志的线程只把当前文件改名、重新 open，排序号和压缩交给 LogArchiver
+     */
+    class FileSink : public Sink
+    {
+    public:
+        /**
+         * @param base_filename  基础文件名 (如 "app.log")
+         * @param max_size       单个日志文件最大字节数 (默认10MB)
+         * @param max_files      保留的日志文件个数 (默认5个)
+         * @param flush_interval 日志在缓冲区里最多停留的秒数 (默认3秒)
+         * @param buffer_size    写缓冲区大小 (默认256KB)
+         */
+        explicit FileSink(const std::string &base_filename,
+                          size_t max_size = 10 * 1024 * 1024,
+                          uint8_t max_files = 5,
+                          int flush_interval = 3,
+                          size_t buffer_size = 256 * 1024)
+            : m_base_filename(base_filename),
+              m_max_size(max_size),
+              m_max_files(max_files),
+              m_flush_interval(flush_interval),
+              m_buffer(std::max<size_t>(buffer_size, 4096))
+        {
+            openFile();
+        }
+
+        ~FileSink()
+        {
+            writeBuffer();
+            if (m_fd >= 0)
+                ::close(m_fd);
+        }
+
+        // 除了按大小，每隔 interval 也轮转一次（比如一天一份），0 表示只按大小
+        void setRotateInterval(std::chrono::seconds interval)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_rotate_interval = static_cast<time_t>(interval.count());
+            m_next_rotate = m_rotate_interval > 0 ? time(nullptr) + m_rotate_interval : 0;
+        }
+
+        // 轮转下来的文件是否 gzip 压缩（默认压缩），在第一次轮转前设置
+        void setCompress(bool compress)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_compress = compress;
+        }
+
+        void log(LogLevel level, const std::string &message) override
+        {
+            logTimed(level, message, wallClockNs());
+        }
+
+        // 时间戳用调用点的时刻，精确到微秒
+        void logTimed(LogLevel level, const std::string &message, int64_t wall_ns) override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            time_t sec = static_cast<time_t>(wall_ns / 1000000000);
+            updateTime(sec);
+            unsigned usec = static_cast<unsigned>(wall_ns % 1000000000 / 1000);
+            for (int i = TIME_LEN - 1; i > SEC_LEN; --i, usec /= 10)
+                m_time_text[i] = static_cast<char>('0' + usec % 10);
+
+            const char *name = levelName(level);
+            size_t name_len = strlen(name);
+            size_t need = TIME_LEN + 2 + name_len + 2 + message.size() + 1;
+
+            // 检查是否需要轮转
+            if (m_current_size + m_used + need > m_max_size || (m_next_rotate > 0 && sec >= m_next_rotate))
+            {
+                writeBuffer();
+                rotateFile();
+                if (m_rotate_interval > 0)
+                    m_next_rotate = sec + m_rotate_interval;
+            }
+            if (m_used + need > m_buffer.size())
+                writeBuffer();
+            if (need > m_buffer.size())
+            {
+                // 比整个缓冲区还长的一行单独写
+                std::string line(m_time_text, TIME_LEN);
+                line.append(" [").append(name).append("] ").append(message).append("\n");
+                writeAll(line.data(), line.size());
+                return;
+            }
+
+            char *p = m_buffer.data() + m_used;
+            memcpy(p, m_time_text, TIME_LEN);
+            p += TIME_LEN;
+            *p++ = ' ';
+            *p++ = '[';
+            memcpy(p, name, name_len);
+            p += name_len;
+            *p++ = ']';
+            *p++ = ' ';
+            memcpy(p, message.data(), message.size());
+            p += message.size();
+            *p++ = '\n';
+            m_used += need;
+
+            if (sec - m_last_write >= m_flush_interval)
+                writeBuffer();
+        }
+
+        void flush() override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            writeBuffer();
+        }
+
+    private:
+        static const int SEC_LEN = 19;  // "YYYY-mm-dd HH:MM:SS"
+        static const int TIME_LEN = 26; // "YYYY-mm-dd HH:MM:SS.uuuuuu"
+
+        void openFile()
+        {
+            m_fd = ::open(m_base_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (m_fd < 0)
+            {
+                throw std::runtime_error("无法打开日志文件: " + m_base_filename);
+            }
+            struct stat st;
+            m_current_size = fstat(m_fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+        }
+
+        // 当前文件改成一个临时名字交给归档线程，打开的 fd 跟着改名后的文件走，新文件打开后再关
+        void rotateFile()
+        {
+            std::string pending = m_base_filename + ".rotating." + std::to_string(m_cached_sec) + "." +
+                                  std::to_string(m_rotations++);
+            if (std::rename(m_base_filename.c_str(), pending.c_str()) != 0)
+                return;
+            int old_fd = m_fd;
+            size_t old_size = m_current_size;
+            try
+            {
+                openFile();
+            }
+            catch (const std::exception &)
+            {
+                // 新文件打不开就改回原名继续写
+                std::rename(pending.c_str(), m_base_filename.c_str());
+                m_fd = old_fd;
+                m_current_size = old_size;
+                return;
+            }
+            ::close(old_fd);
+            if (!m_archiver)
+                m_archiver.reset(new LogArchiver(m_base_filename, m_max_files, m_compress));
+            m_archiver->submit(pending);
+        }
+
+        void updateTime(time_t sec)
+        {
+            if (sec == m_cached_sec)
+                return;
+            m_cached_sec = sec;
+            std::tm tm;
+            localtime_r(&sec, &tm); // 线程安全版本
+            char buffer[32];
+            strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+            memcpy(m_time_text, buffer, SEC_LEN);
+            m_time_text[SEC_LEN] = '.';
+        }
+
+        void writeBuffer()
+        {
+            if (m_used > 0)
+                writeAll(m_buffer.data(), m_used);
+            m_used = 0;
+            m_last_write = m_cached_sec;
+        }
+
+        // 写失败（磁盘满、SD 卡出错）时丢掉这一批，不卡住日志线程
+        void writeAll(const char *data, size_t len)
+        {
+            size_t off = 0;
+            while (off < len)
+            {
+                ssize_t n = ::write(m_fd, data + off, len - off);
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    break;
+                }
+                off += static_cast<size_t>(n);
+            }
+            m_current_size += off;
+        }
+
+        std::string m_base_filename;
+        int m_fd = -1;
+        size_t m_current_size = 0;
+        const size_t m_max_size;
+        const uint8_t m_max_files;
+        const int m_flush_interval;
+        std::vector<char> m_buffer;
+        size_t m_used = 0;
+        time_t m_cached_sec = 0;
+        time_t m_last_write = 0;
+        char m_time_text[TIME_LEN] = {};
+        time_t m_rotate_interval = 0;
+        time_t m_next_rotate = 0;
+        bool m_compress = true;
+        uint64_t m_rotations = 0;
+        std::mutex m_mutex;
+        std::unique_ptr<LogArchiver> m_archiver; // 最后析构：先关文件，再等归档做完
+    };
+
+    /**
+     * @brief 二进制日志文件，配合 Logger::setBinary(true) 使用
+     * 格式见 binary 命名空间的说明，用 test/log_decode.cpp 转成文本
+     */
+    class BinaryFileSink : public Sink
+    {
+    public:
+        /**
+         * @param filename    文件名 (如 "log/myapp.blog")
+         * @param max_size    单个文件最大字节数 (默认10MB)，超过后和 FileSink 一样交给 LogArchiver 轮转压缩
+         * @param max_files   保留的文件个数 (默认5个)
+         * @param buffer_size stdio 缓冲区大小 (默认64KB)
+         */
+        explicit BinaryFileSink(const std::string &filename,
+                                size_t max_size = 10 * 1024 * 1024,
+                                uint8_t max_files = 5,
+                                size_t buffer_size = 64 * 1024)
+            : m_filename(filename), m_max_size(max_size), m_max_files(max_files), m_buffer(buffer_size)
+        {
+            if (!openFile())
+            {
+                throw std::runtime_error("无法打开日志文件: " + filename);
+            }
+        }
+
+        ~BinaryFileSink()
+        {
+            if (m_file)
+                fclose(m_file);
+        }
+
+        bool binary() const override { return true; }
+
+        // 文件里存墙上时间，解码时不用再知道单调时钟的起点
+        void logRecord(const LogRecord &record, int64_t wall_ns) override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!ready())
+                return;
+            if (record.kind == LogRecord::TEXT)
+            {
+                writeText(record.level, wall_ns, record.text, record.len);
+                return;
+            }
+            if (record.site >= m_sites_written.size() || !m_sites_written[record.site])
+            {
+                LogSite site;
+                if (!SiteRegistry::instance().get(record.site, site))
+                    return;
+                writeSite(record.site, site);
+            }
+            putTag('R');
+            put(record.site);
+            put(wall_ns);
+            put(record.len);
+            putBytes(record.text, record.len);
+            // 出错前后的几条别留在缓冲区里
+            if (record.level >= LogLevel::ERROR)
+                fflush(m_file);
+        }
+
+        void log(LogLevel level, const std::string &message) override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!ready())
+                return;
+            writeText(level, wallClockNs(), message.data(), message.size());
+        }
+
+        void flush() override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_file)
+                fflush(m_file);
+        }
+
+    private:
+        // 需要时先轮转；文件打不开（SD 卡拔了）时丢掉这条，下一条再试
+        bool ready()
+        {
+            if (!m_file && !openFile())
+                return false;
+            if (m_size >= m_max_size)
+                rotateFile();
+            return m_file != nullptr;
+        }
+
+        // 新文件先写文件头；调用点描述按文件重新写，每个文件都能单独解码
+        bool openFile()
+        {
+            m_file = fopen(m_filename.c_str(), "ab");
+            if (!m_file)
+                return false;
+            setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+            fseek(m_file, 0, SEEK_END);
+            long size = ftell(m_file);
+            m_size = size > 0 ? static_cast<size_t>(size) : 0;
+            if (m_size == 0)
+            {
+                putBytes(binary::MAGIC, sizeof(binary::MAGIC));
+                put(binary::VERSION);
+            }
+            m_sites_written.clear();
+            return true;
+        }
+
+        // 和 FileSink 一样：改成临时名字交给归档线程排序号、gzip
+        void rotateFile()
+        {
+            std::string pending = m_filename + ".rotating." + std::to_string(time(nullptr)) + "." +
+                                  std::to_string(m_rotations++);
+            fflush(m_file);
+            if (std::rename(m_filename.c_str(), pending.c_str()) != 0)
+            {
+                m_size = 0; // 改不了名就继续写，过 max_size 再试
+                return;
+            }
+            // 新旧文件共用 m_buffer，先关旧的
+            fclose(m_file);
+            if (!openFile())
+            {
+                // 新文件打不开就改回原名继续写，还不行就等下一条再试
+                std::rename(pending.c_str(), m_filename.c_str());
+                openFile();
+                return;
+            }
+            if (!m_archiver)
+                m_archiver.reset(new LogArchiver(m_filename, m_max_files, true));
+            m_archiver->submit(pending);
+        }
+
+        template <typename T>
+        void put(T v)
+        {
+            putBytes(&v, sizeof(v));
+        }
+
+        void putTag(char tag)
+        {
+            fputc(tag, m_file);
+            ++m_size;
+        }
+
+        void putBytes(const void *data, size_t len)
+        {
+            fwrite(data, 1, len, m_file);
+            m_size += len;
+        }
+
+        void putString(const char *s)
+        {
+            size_t n = std::min<size_t>(strlen(s), 0xFFFF);
+            put(static_cast<uint16_t>(n));
+            putBytes(s, n);
+        }
+
+        void writeSite(uint32_t id, const LogSite &site)
+        {
+            putTag('S');
+            put(id);
+            put(static_cast<uint8_t>(site.level));
+            putString(site.location);
+            putString(site.func);
+            putString(site.fmt);
+            if (id >= m_sites_written.size())
+                m_sites_written.resize(id + 1, false);
+            m_sites_written[id] = true;
+        }
+
+        void writeText(LogLevel level, int64_t time, const char *text, size_t len)
+        {
+            len = std::min<size_t>(len, 0xFFFF);
+            putTag('T');
+            put(static_cast<uint8_t>(level));
+            put(time);
+            put(static_cast<uint16_t>(len));
+            putBytes(text, len);
+        }
+
+        std::string m_filename;
+        const size_t m_max_size;
+        const uint8_t m_max_files;
+        std::vector<char> m_buffer;
+        FILE *m_file = nullptr;
+        size_t m_size = 0;
+        uint64_t m_rotations = 0;
+        std::vector<bool> m_sites_written;
+        std::mutex m_mutex;
+        std::unique_ptr<LogArchiver> m_archiver; // 最后析构：先关文件，再等归档做完
+    };
+
+    // ==================== 异步日志引擎 ====================
+    inline void fillText(LogRecord &r, LogLevel level, const std::string &message, int64_t time)
+    {
+        r.level = level;
+        r.kind = LogRecord::TEXT;
+        r.time = time;
+        r.len = static_cast<uint16_t>(std::min(message.size(), static_cast<size_t>(LogRecord::TEXT_SIZE)));
+        memcpy(r.text, message.data(), r.len);
+        if (message.size() > LogRecord::TEXT_SIZE)
+            memcpy(r.text + LogRecord::TEXT_SIZE - 3, "...", 3);
+    }
+
+    /**
+     * @brief 有界无锁环形队列（Vyukov）
+     * 每个槽带一个序号：生产者 CAS 抢入队位置，写好槽再发布序号；消费者同理。
+     * 容量向上取整到 2 的幂
+     */
+    template <typename T>
+    class BoundedRing
+    {
+    public:
+        explicit BoundedRing(size_t capacity)
+        {
+            size_t n = 2;
+            while (n < capacity)
+                n <<= 1;
+            m_mask = n - 1;
+            m_cells.reset(new Cell[n]);
+            for (size_t i = 0; i < n; ++i)
+                m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        // 满了返回 false；fill(T&) 在槽里原地写数据
+        template <typename Fill>
+        bool tryPush(Fill &&fill)
+        {
+            size_t pos = m_enqueue.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell &cell = m_cells[pos & m_mask];
+                size_t seq = cell.seq.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        fill(cell.data);
+                        cell.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    pos = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+
+        // 空了返回 false；use(T&) 在槽里原地读数据
+        template <typename Use>
+        bool tryPop(Use &&use)
+        {
+            size_t pos = m_dequeue.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell &cell = m_cells[pos & m_mask];
+                size_t seq = cell.seq.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        use(cell.data);
+                        cell.seq.store(pos + m_mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    pos = m_dequeue.load(std::memory_order_relaxed);
+            }
+        }
+
+        // 近似值，只用于判断空和统计
+        size_t size() const
+        {
+            size_t tail = m_dequeue.load(std::memory_order_acquire);
+            size_t head = m_enqueue.load(std::memory_order_acquire);
+            return head > tail ? head - tail : 0;
+        }
+        bool empty() const { return size() == 0; }
+        size_t capacity() const { return m_mask + 1; }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> seq;
+            T data;
+        };
+
+        // 入队、出队位置各占一条 cache line，生产者和消费者不互相踩
+        char m_pad0[64];
+        std::atomic<size_t> m_enqueue{0};
+        char m_pad1[64 - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> m_dequeue{0};
+        char m_pad2[64 - sizeof(std::atomic<size_t>)];
+        size_t m_mask;
+        std::unique_ptr<Cell[]> m_cells;
     };
 
-    // 在 ElegantLog.hpp 中完善 FileSink 类
-    class FileSink : public Sink
+    // 队列满时的处理策略
+    enum class OverflowPolicy
+    {
+        BLOCK,       // 打日志的线程等后台腾出槽位，不丢日志
+        DROP_NEWEST, // 丢弃新来的
+        DROP_OLDEST, // 丢弃队列里最旧的
+        COUNT        // 丢弃新来的，队列空出来后写一行 "dropped N log records"
+    };
+
+    struct LogQueueStats
+    {
+        size_t capacity = 0;
+        size_t depth = 0;      // 当前排队数
+        size_t high_water = 0; // 出现过的最大深度
+        uint64_t dropped = 0;
+        uint64_t written = 0;
+    };
+
+    inline std::string describeQueue(const LogQueueStats &st)
+    {
+        return "log queue: capacity " + std::to_string(st.capacity) + " per thread, high water " +
+               std::to_string(st.high_water) + ", dropped " + std::to_string(st.dropped) + ", written " +
+               std::to_string(st.written);
+    }
+
+    /**
+     * @brief 后台写日志的线程
+     * 每个打日志的线程第一次写时分到自己的环形缓冲区，之后只写自己的那块，
+     * 线程之间不争同一个入队位置；后台线程轮流取各缓冲区的队首，按时间戳归并后写出。
+     * 只有在后台线程睡着时生产者才去唤醒。
+     * 每块缓冲区有上限，满了按 OverflowPolicy 处理，SD 卡卡住时内存不会一直涨
+     */
+    class AsyncLogEngine
     {
     public:
+        using Handler = std::function<void(const LogRecord &)>;
+
         /**
-         * @param base_filename  基础文件名 (如 "app.log")
-         * @param max_size       单个日志文件最大字节数 (默认10MB)
-         * @param max_files      保留的日志文件个数 (默认5个)
-         * @param flush_interval 自动刷新间隔(秒) (默认3秒)
+         * @param capacity 每个线程的缓冲区能放的记录数
+         * @param idle     写完一批、准备睡眠前调用（让 sink 把缓冲区写到文件）
          */
-        explicit FileSink(const std::string &base_filename,
-                          size_t max_size = 10 * 1024 * 1024,
-                          uint8_t max_files = 5,
-                          int flush_interval = 3)
-            : m_base_filename(base_filename),
-              m_max_size(max_size),
-              m_max_files(max_files),
-              m_flush_interval(flush_interval)
+        AsyncLogEngine(Handler handler, size_t capacity = 256, OverflowPolicy policy = OverflowPolicy::BLOCK,
+                       std::function<void()> idle = nullptr)
+            : m_handler(std::move(handler)), m_idle(std::move(idle)), m_capacity(capacity), m_policy(policy),
+              m_id(nextId()), m_stats_at(monotonicNs()), m_running(true)
         {
-            openFile();
-            startFlushThread();
+            m_worker = std::thread([this]
+                                   { work(); });
+        }
+        ~AsyncLogEngine()
+        {
+            stop();
         }
 
-        ~FileSink()
+        // 停止前把各缓冲区里剩下的写完；之后 push 一律返回 false，不会再等队列腾空
+        void stop()
         {
-            stopFlushThread();
-            if (m_file.is_open())
+            m_stopped.store(true);
             {
-                m_file.flush();
-                m_file.close();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = false;
+            }
+            m_cv.notify_one();
+            if (m_worker.joinable())
+            {
+                m_worker.join();
             }
         }
 
-        void log(LogLevel level, const std::string &message) override
+        bool stopped() const { return m_stopped.load(std::memory_order_relaxed); }
+
+        // 被丢弃时返回 false
+        bool push(LogLevel level, const std::string &message)
         {
-            std::lock_guard<std::mutex> lock(m_mutex);
+            int64_t now = monotonicNs();
+            return push([level, &message, now](LogRecord &r)
+                        { fillText(r, level, message, now); });
+        }
 
-            // 检查是否需要轮转
-            if (m_current_size + message.size() > m_max_size)
+        // fill(LogRecord&) 在本线程缓冲区的槽里原地写记录，记录的 time 用于归并
+        template <typename Fill>
+        bool push(Fill &&fill)
+        {
+            ThreadBuffer &buffer = localBuffer();
+            while (!buffer.ring.tryPush(fill))
             {
-                rotateFile();
+                switch (m_policy)
+                {
+                case OverflowPolicy::BLOCK:
+                    // 后台线程已经停了就没人腾地方
+                    if (m_stopped.load(std::memory_order_relaxed))
+                    {
+                        m_dropped.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    wake();
+                    std::this_thread::yield();
+                    break;
+                case OverflowPolicy::DROP_OLDEST:
+                    if (buffer.ring.tryPop([](LogRecord &) {}))
+                        m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                default:
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    wake();
+                    return false;
+                }
             }
-            // 写入日志 (包含时间戳)
-            auto now = std::chrono::system_clock::now();
-            m_file << formatTime(now) << " [" << levelToString(level) << "] "
-                   << message << '\n';
-            m_current_size += message.size();
-
-            // 标记需要刷新
-            m_needs_flush = true;
+            size_t depth = buffer.ring.size();
+            if (depth > buffer.high_water.load(std::memory_order_relaxed))
+                buffer.high_water.store(depth, std::memory_order_relaxed);
+            wake();
+            return true;
         }
 
-        void flush() override
+        // 除调用线程以外，还有没有线程往这个引擎写过（已退出且被回收的不算）
+        bool usedByOtherThreads()
         {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            if (m_file.is_open())
+            const ThreadSlot &own = threadSlot();
+            std::lock_guard<std::mutex> lock(m_buffers_mutex);
+            for (auto &b : m_buffers)
             {
-                m_file.flush();
-                m_needs_flush = false;
+                if (own.engine != m_id || b != own.buffer)
+                    return true;
             }
+            return false;
         }
 
-    private:
-        void openFile()
+        // depth 是所有线程缓冲区的总和，high_water 是单个缓冲区出现过的最大深度
+        LogQueueStats stats()
         {
-            m_file.open(m_base_filename, std::ios::app);
-            if (!m_file.is_open())
+            LogQueueStats st;
+            st.capacity = m_capacity;
             {
-                throw std::runtime_error("无法打开日志文件: " + m_base_filename);
+                std::lock_guard<std::mutex> lock(m_buffers_mutex);
+                for (auto &b : m_buffers)
+                {
+                    st.depth += b->ring.size();
+                    st.high_water = std::max(st.high_water, b->high_water.load(std::memory_order_relaxed));
+                }
             }
-            m_file.seekp(0, std::ios::end);
-            m_current_size = m_file.tellp();
+            st.high_water = std::max(st.high_water, m_retired_high_water.load(std::memory_order_relaxed));
+            st.dropped = m_dropped.load(std::memory_order_relaxed);
+            st.written = m_written.load(std::memory_order_relaxed);
+            return st;
         }
 
-        void rotateFile()
+    private:
+        struct ThreadBuffer
         {
-            m_file.close();
+            explicit ThreadBuffer(size_t capacity) : ring(capacity) {}
 
-            // 轮转旧文件 (app.log.1 → app.log.2, etc.)
-            for (int i = m_max_files - 1; i > 0; --i)
+            BoundedRing<LogRecord> ring;
+            std::atomic<size_t> high_water{0};
+            std::atomic<bool> closed{false}; // 线程已退出，取空后回收
+        };
+
+        // 线程退出时把缓冲区标记为关闭
+        struct ThreadSlot
+        {
+            uint64_t engine = 0;
+            std::shared_ptr<ThreadBuffer> buffer;
+
+            ~ThreadSlot()
             {
-                std::string old_name = m_base_filename + "." + std::to_string(i);
-                std::string new_name = m_base_filename + "." + std::to_string(i + 1);
-                std::rename(old_name.c_str(), new_name.c_str());
+                if (buffer)
+                    buffer->closed = true;
             }
+        };
 
-            // 当前文件 → app.log.1
-            std::rename(m_base_filename.c_str(), (m_base_filename + ".1").c_str());
-
-            // 创建新文件
-            openFile();
+        static uint64_t nextId()
+        {
+            static std::atomic<uint64_t> id{0};
+            return ++id;
         }
 
-        std::string formatTime(const std::chrono::system_clock::time_point &tp)
+        static ThreadSlot &threadSlot()
         {
-            auto in_time_t = std::chrono::system_clock::to_time_t(tp);
-            std::tm tm;
-            localtime_r(&in_time_t, &tm); // 线程安全版本
-
-            char buffer[80];
-            strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
-            return buffer;
+            static thread_local ThreadSlot slot;
+            return slot;
         }
 
-        void startFlushThread()
+        // 按引擎编号区分，setQueue 重建引擎后线程会重新登记
+        ThreadBuffer &localBuffer()
         {
-            m_flush_thread = std::thread([this]
-                                         {
-            while (!m_stop_flush_thread) {
-                std::this_thread::sleep_for(std::chrono::seconds(m_flush_interval));
-                if (m_needs_flush) {
-                    flush();
-                }
-            } });
+            ThreadSlot &slot = threadSlot();
+            if (slot.engine != m_id)
+            {
+                if (slot.buffer)
+                    slot.buffer->closed = true;
+                slot.buffer = std::make_shared<ThreadBuffer>(m_capacity);
+                slot.engine = m_id;
+                std::lock_guard<std::mutex> lock(m_buffers_mutex);
+                m_buffers.push_back(slot.buffer);
+                m_buffers_changed = true;
+            }
+            return *slot.buffer;
         }
 
-        void stopFlushThread()
+        void wake()
         {
-            m_stop_flush_thread = true;
-            if (m_flush_thread.joinable())
+            // 和 work() 里先置 m_sleeping 再查队列配对
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false))
             {
-                m_flush_thread.join();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_cv.notify_one();
             }
         }
 
-        std::string m_base_filename;
-        std::ofstream m_file;
-        size_t m_current_size = 0;
-        const size_t m_max_size;
-        const uint8_t m_max_files;
-        const int m_flush_interval;
-        std::mutex m_mutex;
-        std::thread m_flush_thread;
-        std::atomic<bool> m_stop_flush_thread{false};
-        std::atomic<bool> m_needs_flush{false};
-    };
+        // COUNT 策略：把这段时间丢掉的条数补一行
+        void reportDropped()
+        {
+            uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+            if (m_policy != OverflowPolicy::COUNT || dropped == m_reported)
+                return;
+            LogRecord r;
+            fillText(r, LogLevel::WARN, "[WARN] log queue full, dropped " + std::to_string(dropped - m_reported) + " log records",
+                     monotonicNs());
+            m_handler(r);
+            m_reported = dropped;
+        }
 
-    // ==================== 异步日志引擎 ====================
-    class AsyncLogEngine
-    {
-    public:
-        AsyncLogEngine() : m_running(true)
+        // 每分钟最多一行队列统计，只在丢过记录或高水位变化时输出
+        void reportStats()
         {
-            m_worker = std::thread([this]
-                                   { work(); });
+            int64_t now = monotonicNs();
+            if (now - m_stats_at < STATS_INTERVAL_NS)
+                return;
+            m_stats_at = now;
+            LogQueueStats st = stats();
+            if (st.dropped == m_stats_dropped && st.high_water == m_stats_high_water)
+                return;
+            m_stats_dropped = st.dropped;
+            m_stats_high_water = st.high_water;
+            LogRecord r;
+            fillText(r, LogLevel::INFO, "[INFO] " + describeQueue(st), now);
+            m_handler(r);
         }
-        ~AsyncLogEngine()
+
+        // 新登记的缓冲区拿过来，退出线程留下的空缓冲区回收
+        void refreshBuffers(std::vector<std::shared_ptr<ThreadBuffer>> &local)
         {
-            stop();
+            std::lock_guard<std::mutex> lock(m_buffers_mutex);
+            for (auto it = m_buffers.begin(); it != m_buffers.end();)
+            {
+                if ((*it)->closed && (*it)->ring.empty())
+                {
+                    size_t high = (*it)->high_water.load(std::memory_order_relaxed);
+                    if (high > m_retired_high_water.load(std::memory_order_relaxed))
+                        m_retired_high_water.store(high, std::memory_order_relaxed);
+                    it = m_buffers.erase(it);
+                    m_buffers_changed = true;
+                }
+                else
+                    ++it;
+            }
+            if (m_buffers_changed)
+            {
+                local = m_buffers;
+                m_buffers_changed = false;
+            }
         }
 
-        void stop()
+        // 每次从各缓冲区的队首里挑时间最早的一条写出，直到全部取空
+        void drain(const std::vector<std::shared_ptr<ThreadBuffer>> &buffers)
         {
+            auto use = [this](LogRecord &r)
             {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                m_running = false;
+                m_handler(r);
+                m_written.fetch_add(1, std::memory_order_relaxed);
+            };
+            if (buffers.size() == 1)
+            {
+                while (buffers[0]->ring.tryPop(use))
+                {
+                }
+                return;
             }
-            m_cv.notify_one();
-            if (m_worker.joinable())
+            // 各缓冲区先取一条到本线程的暂存槽里再比时间：DROP_OLDEST 的生产者也会从队首出队，
+            // 不能只看不取
+            m_heads.resize(buffers.size());
+            for (size_t i = 0; i < buffers.size(); ++i)
+                m_heads[i].valid = popHead(*buffers[i], m_heads[i].record);
+            while (true)
             {
-                m_worker.join();
+                size_t earliest = buffers.size();
+                for (size_t i = 0; i < buffers.size(); ++i)
+                {
+                    if (m_heads[i].valid &&
+                        (earliest == buffers.size() || m_heads[i].record.time < m_heads[earliest].record.time))
+                        earliest = i;
+                }
+                if (earliest == buffers.size())
+                    return;
+                use(m_heads[earliest].record);
+                m_heads[earliest].valid = popHead(*buffers[earliest], m_heads[earliest].record);
             }
         }
 
-        template <typename F>
-        void submit(F &&task)
+        // 只拷有效部分，不拷整个 text
+        static bool popHead(ThreadBuffer &buffer, LogRecord &out)
+        {
+            return buffer.ring.tryPop([&out](LogRecord &r)
+                                      {
+                memcpy(&out, &r, offsetof(LogRecord, text));
+                memcpy(out.text, r.text, r.len); });
+        }
+
+        bool anyPending(const std::vector<std::shared_ptr<ThreadBuffer>> &buffers) const
         {
+            for (auto &b : buffers)
             {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                m_queue.emplace(std::forward<F>(task));
+                if (!b->ring.empty())
+                    return true;
             }
-            m_cv.notify_one();
+            return false;
         }
 
-    private:
         void work()
         {
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;
             while (true)
             {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(m_mutex);
-                    m_cv.wait(lock, [this]
-                              { return !m_queue.empty() || !m_running; });
+                refreshBuffers(buffers);
+                drain(buffers);
+                reportDropped();
+                reportStats();
 
-                    if (!m_running && m_queue.empty())
-                        break;
-
-                    if (!m_queue.empty())
-                    {
-                        task = std::move(m_queue.front());
-                        m_queue.pop();
-                    }
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (!m_running)
+                {
+                    lock.unlock();
+                    refreshBuffers(buffers);
+                    drain(buffers);
+                    reportDropped();
+                    if (m_idle)
+                        m_idle();
+                    break;
                 }
-                if (task)
-                    task();
+                m_sleeping.store(true);
+                if (anyPending(buffers) || m_buffers_changed)
+                {
+                    m_sleeping.store(false);
+                    continue;
+                }
+                if (m_idle && m_written.load(std::memory_order_relaxed) != m_idle_written)
+                {
+                    // 睡之前让 sink 把缓冲区写出去；这期间来的日志下一轮再取
+                    m_sleeping.store(false);
+                    lock.unlock();
+                    m_idle_written = m_written.load(std::memory_order_relaxed);
+                    m_idle();
+                    continue;
+                }
+                m_cv.wait(lock, [this]
+                          { return !m_sleeping.load() || !m_running; });
+                m_sleeping.store(false);
             }
         }
 
-        std::queue<std::function<void()>> m_queue;
+        Handler m_handler;
+        std::function<void()> m_idle;
+        const size_t m_capacity;
+        const OverflowPolicy m_policy;
+        const uint64_t m_id;
+        struct Head
+        {
+            LogRecord record;
+            bool valid;
+        };
+        std::vector<Head> m_heads; // drain 用，只在后台线程里访问
+        std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+        std::atomic<bool> m_buffers_changed{false};
+        std::mutex m_buffers_mutex;
+        std::atomic<size_t> m_retired_high_water{0};
+        std::atomic<uint64_t> m_dropped{0};
+        std::atomic<uint64_t> m_written{0};
+        uint64_t m_reported = 0;
+        static const int64_t STATS_INTERVAL_NS = 60LL * 1000000000;
+        int64_t m_stats_at;
+        uint64_t m_stats_dropped = 0;
+        size_t m_stats_high_water = 0;
+        uint64_t m_idle_written = 0;
+        std::atomic<bool> m_stopped{false};
+        std::atomic<bool> m_sleeping{false};
         std::mutex m_mutex;
         std::condition_variable m_cv;
         bool m_running;
@@ -387,21 +1664,61 @@ namespace ElegantLog
     class Logger
     {
     public:
-        Logger() : m_level(LogLevel::INFO), m_async(true) {}
+        Logger() : m_level(LogLevel::INFO), m_async(true)
+        {
+            // 先于 Logger 构造完成，析构就晚于 Logger：~Logger 写剩下的二进制记录时还要查调用点
+            SiteRegistry::instance();
+            startEngine();
+        }
 
         void setLevel(LogLevel level = ElegantLog::LogLevel::DEBUG) { m_level = level; }
         LogLevel level() const { return m_level; }
+        // 宏在求值参数之前先问这里，关掉的级别只花一次比较
+        bool enabled(LogLevel level) const { return level >= m_level.load(std::memory_order_relaxed); }
 
         void setAsync(bool async)
         {
-            if (async && !m_async)
+            if (async && !m_async_engine)
             {
-                m_async_engine.reset(new AsyncLogEngine());
+                startEngine();
             }
             m_async = async;
         }
         bool async() const { return m_async; }
 
+        /**
+         * @brief 二进制模式：LOG_* 只把时间戳和原始参数放进队列，不在调用线程格式化
+         * 文本 sink 由后台线程格式化；配 BinaryFileSink 时完全不格式化，用 test/log_decode.cpp 离线解码
+         */
+        void setBinary(bool binary) { m_binary = binary; }
+        bool binary() const { return m_binary.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief 设置每个线程日志缓冲区的容量（向上取整到 2 的幂）和满了以后的策略
+         * 每条记录约 500 字节，每个打日志的线程都有一个缓冲区，容量按线程数折算总内存
+         * 会重建队列，旧队列里的记录先写完。重建时别的线程可能正往旧队列里写，
+         * 所以和 initDefaultLogger 一样只能在其他线程开始打日志前调用
+         * @return 已经有别的线程打过日志时什么都不改，返回 false
+         */
+        bool setQueue(size_t capacity, OverflowPolicy policy)
+        {
+            if (m_async_engine && m_async_engine->usedByOtherThreads())
+                return false;
+            m_queue_capacity = capacity;
+            m_overflow_policy = policy;
+            if (m_async_engine)
+            {
+                m_async_engine->stop();
+                startEngine();
+            }
+            return true;
+        }
+
+        LogQueueStats queueStats() const
+        {
+            return m_async_engine ? m_async_engine->stats() : LogQueueStats();
+        }
+
         void addSink(std::shared_ptr<Sink> sink)
         {
             std::lock_guard<std::mutex> lock(m_sinks_mutex);
@@ -414,86 +1731,369 @@ namespace ElegantLog
             m_sinks.clear();
         }
 
-        template <typename... Args>
-        void log(LogLevel level, const std::string &fmt, Args &&...args)
+        // LOG_* 宏走这里：location 是 "文件:行号" 字面量，spec 是调用点编译期切好的格式串。
+        // 级别已经由宏检查过
+        template <size_t N, typename... Args>
+        void logAt(LogLevel level, const char *location, const char *func,
+                   const detail::FormatSpec<N> &spec, const Args &...args)
         {
-            if (level < m_level)
-                return;
-
-            auto message = format("[{}] {}", levelToString(level),
-                                  format(fmt, std::forward<Args>(args)...));
+            // 每个线程复用一块缓冲区，格式化时不再反复分配
+            static thread_local std::string buf;
+            buf.clear();
+            buf += '[';
+            buf += levelName(level);
+            buf += "] [";
+            buf += location;
+            buf += "][";
+            buf += func;
+            buf += "] ";
+            detail::formatTo(buf, spec, args...);
+            dispatch(level, buf);
+        }
 
-            if (m_async)
+        // 二进制模式下 LOG_* 走这里，site 是调用点登记的编号
+        template <typename... Args>
+        void logBinary(uint32_t site, LogLevel level, const Args &...args)
+        {
+            int64_t now = monotonicNs();
+            auto fill = [&](LogRecord &r)
             {
-                if (!m_async_engine)
-                {
-                    m_async_engine.reset(new AsyncLogEngine());
-                }
-                m_async_engine->submit([this, level, message]
-                                       { logToSinks(level, message); });
+                r.level = level;
+                r.kind = LogRecord::BINARY;
+                r.site = site;
+                r.time = now;
+                detail::ArgWriter w = {r.text, r.text + LogRecord::TEXT_SIZE};
+                detail::encodeArgs(w, args...);
+                r.len = static_cast<uint16_t>(w.p - r.text);
+            };
+            if (useQueue())
+            {
+                m_async_engine->push(fill);
             }
             else
             {
-                logToSinks(level, message);
+                static thread_local LogRecord record;
+                fill(record);
+                writeRecord(record);
+                flushSinks();
             }
         }
 
+        // 运行时格式串
+        template <typename... Args>
+        void log(LogLevel level, const std::string &fmt, Args &&...args)
+        {
+            if (level < m_level)
+                return;
+
+            static thread_local std::string buf;
+            buf.clear();
+            buf += '[';
+            buf += levelName(level);
+            buf += "] ";
+            detail::formatRuntime(buf, fmt.c_str(), args...);
+            dispatch(level, buf);
+        }
+
         static Logger &instance()
         {
             static Logger logger;
             return logger;
         }
 
+        /**
+         * @brief 连续重复的相同消息只写第一条，后面的计数，
+         * 换了消息（或者折叠超过 window）时补一行 "last message repeated N times"。
+         * 0 表示不折叠（默认）
+         */
+        void setRepeatWindow(std::chrono::seconds window)
+        {
+            std::lock_guard<std::mutex> lock(m_sinks_mutex);
+            if (m_repeats > 0)
+                writeRepeats();
+            m_repeat_window = std::chrono::duration_cast<std::chrono::nanoseconds>(window).count();
+            m_has_last = false;
+        }
+
+        // 停掉后台线程后还在打日志的线程（paho、分发线程）改为同步写
         ~Logger()
         {
             if (m_async_engine)
             {
                 m_async_engine->stop();
+                LogRecord r;
+                fillText(r, LogLevel::INFO, "[INFO] " + describeQueue(m_async_engine->stats()), monotonicNs());
+                writeRecord(r);
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_sinks_mutex);
+                if (m_repeats > 0)
+                    writeRepeats();
             }
+            flushSinks();
         }
 
     private:
-        void logToSinks(LogLevel level, const std::string &message)
+        void startEngine()
+        {
+            m_async_engine.reset(new AsyncLogEngine([this](const LogRecord &record)
+                                                    { writeRecord(record); },
+                                                    m_queue_capacity, m_overflow_policy, [this]
+                                                    { flushSinks(); }));
+        }
+
+        bool useQueue() const
+        {
+            return m_async && m_async_engine && !m_async_engine->stopped();
+        }
+
+        void dispatch(LogLevel level, const std::string &message)
+        {
+            if (useQueue())
+            {
+                m_async_engine->push(level, message);
+            }
+            else
+            {
+                static thread_local LogRecord record;
+                fillText(record, level, message, monotonicNs());
+                writeRecord(record);
+                flushSinks();
+            }
+        }
+
+        void flushSinks()
         {
             std::lock_guard<std::mutex> lock(m_sinks_mutex);
             for (auto &sink : m_sinks)
             {
                 if (sink)
+                    sink->flush();
+            }
+        }
+
+        void writeRecord(const LogRecord &record)
+        {
+            std::lock_guard<std::mutex> lock(m_sinks_mutex);
+            if (m_repeat_window > 0)
+            {
+                bool same = m_has_last && sameMessage(record, m_last);
+                if (m_repeats > 0 && (!same || record.time - m_repeat_since >= m_repeat_window))
+                    writeRepeats();
+                if (same)
+                {
+                    if (m_repeats++ == 0)
+                        m_repeat_since = record.time;
+                    m_repeat_time = record.time;
+                    return;
+                }
+                m_last = record;
+                m_has_last = true;
+            }
+            writeToSinks(record);
+        }
+
+        // 时间戳不算，级别、调用点和内容都一样才是重复
+        static bool sameMessage(const LogRecord &a, const LogRecord &b)
+        {
+            return a.kind == b.kind && a.level == b.level && a.len == b.len &&
+                   (a.kind == LogRecord::TEXT || a.site == b.site) && memcmp(a.text, b.text, a.len) == 0;
+        }
+
+        void writeRepeats()
+        {
+            LogRecord r;
+            fillText(r, m_last.level,
+                     std::string("[") + levelName(m_last.level) + "] last message repeated " + std::to_string(m_repeats) + " times",
+                     m_repeat_time);
+            m_repeats = 0;
+            writeToSinks(r);
+        }
+
+        // 二进制记录只在有文本 sink 时才格式化，而且只格式化一次
+        void writeToSinks(const LogRecord &record)
+        {
+            int64_t wall = m_clock.toWall(record.time);
+            bool formatted = false;
+            for (auto &sink : m_sinks)
+            {
+                if (!sink)
+                    continue;
+                if (sink->binary())
+                {
+                    sink->logRecord(record, wall);
+                    continue;
+                }
+                if (!formatted)
                 {
-                    sink->log(level, message);
+                    formatRecord(record, m_text);
+                    formatted = true;
                 }
+                sink->logTimed(record.level, m_text, wall);
+            }
+        }
+
+        static void formatRecord(const LogRecord &record, std::string &out)
+        {
+            out.clear();
+            LogSite site;
+            if (record.kind == LogRecord::TEXT || !SiteRegistry::instance().get(record.site, site))
+            {
+                out.assign(record.text, record.len);
+                return;
             }
+            out += '[';
+            out += levelName(record.level);
+            out += "] [";
+            out += site.location;
+            out += "][";
+            out += site.func;
+            out += "] ";
+            formatEncoded(out, site.fmt, record.text, record.len);
         }
 
         std::atomic<LogLevel> m_level;
         std::atomic<bool> m_async;
+        std::atomic<bool> m_binary{false};
         std::vector<std::shared_ptr<Sink>> m_sinks;
         std::mutex m_sinks_mutex;
+        std::string m_text;  // writeRecord 复用，受 m_sinks_mutex 保护
+        WallClock m_clock;   // 同上
+        // 重复消息折叠，同上
+        int64_t m_repeat_window = 0;
+        LogRecord m_last;
+        bool m_has_last = false;
+        uint64_t m_repeats = 0;
+        int64_t m_repeat_since = 0;
+        int64_t m_repeat_time = 0;
+        size_t m_queue_capacity = 256;
+        OverflowPolicy m_overflow_policy = OverflowPolicy::BLOCK;
         std::unique_ptr<AsyncLogEngine> m_async_engine;
     };
 
+    // ==================== 限流 ====================
+    // LOG_*_EVERY：每个调用点第 1、n+1、2n+1... 次才输出
+    inline bool everyNth(std::atomic<uint64_t> &count, uint64_t n)
+    {
+        return n <= 1 || count.fetch_add(1, std::memory_order_relaxed) % n == 0;
+    }
+
+    /**
+     * @brief LOG_*_RATE 每个调用点一个：每秒最多放行 hz 条，不攒突发（hz 可以小于 1）
+     * 只有一个原子变量记下次放行的时刻，多个线程抢的时候只有一个成功
+     */
+    class RateLimiter
+    {
+    public:
+        explicit RateLimiter(double hz) : m_interval(hz > 0 ? static_cast<int64_t>(1e9 / hz) : 0) {}
+
+        bool allow()
+        {
+            if (m_interval == 0)
+                return true;
+            int64_t now = monotonicNs();
+            int64_t next = m_next.load(std::memory_order_relaxed);
+            if (now < next)
+                return false;
+            return m_next.compare_exchange_strong(next, now + m_interval, std::memory_order_relaxed);
+        }
+
+    private:
+        const int64_t m_interval;
+        std::atomic<int64_t> m_next{0};
+    };
+
     // ==================== 便捷宏 ====================
 
-#define LOG_TRACE(fmt, ...) \
-    ElegantLog::Logger::instance().log(ElegantLog::LogLevel::TRACE, "[{}:{}][{}] " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
-#define LOG_DEBUG(fmt, ...) \
-    ElegantLog::Logger::instance().log(ElegantLog::LogLevel::DEBUG, "[{}:{}][{}] " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
-#define LOG_INFO(fmt, ...) \
-    ElegantLog::Logger::instance().log(ElegantLog::LogLevel::INFO, "[{}:{}][{}] " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...) \
-    ElegantLog::Logger::instance().log(ElegantLog::LogLevel::WARN, "[{}:{}][{}] " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
-#define LOG_ERROR(fmt, ...) \
-    ElegantLog::Logger::instance().log(ElegantLog::LogLevel::ERROR, "[{}:{}][{}] " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
-#define LOG_FATAL(fmt, ...) \
-    ElegantLog::Logger::instance().log(ElegantLog::LogLevel::FATAL, "[{}:{}][{}] " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
+#define ELEGANTLOG_STR2(x) #x
+#define ELEGANTLOG_STR(x) ELEGANTLOG_STR2(x)
+
+// 编译期去掉低于该级别的日志（0=TRACE ... 5=FATAL），如 -DELEGANTLOG_ACTIVE_LEVEL=2 只保留 INFO 及以上。
+// 被去掉的语句仍做类型和参数个数检查，但不生成代码
+#ifndef ELEGANTLOG_ACTIVE_LEVEL
+#define ELEGANTLOG_ACTIVE_LEVEL 0
+#endif
+
+#if defined(__GNUC__)
+#define ELEGANTLOG_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define ELEGANTLOG_UNLIKELY(x) (x)
+#endif
+
+// fmt 必须是字符串字面量；"{}" 个数和参数个数不一致时编译失败。
+// 先判断级别再求值参数：关掉的级别里 formathex 之类的参数不会被执行。
+// gate_decl/gate 是限流用的调用点静态状态和放行条件，级别关掉时不计数
+#define ELEGANTLOG_LOG_IF(level, gate_decl, gate, fmt, ...)                                                  \
+    do                                                                                                       \
+    {                                                                                                        \
+        static_assert(ElegantLog::detail::countPlaceholders(fmt) ==                                          \
+                          decltype(ElegantLog::detail::argCount(__VA_ARGS__))::value,                        \
+                      "LOG_*: number of {} does not match number of arguments");                             \
+        if (static_cast<int>(level) >= ELEGANTLOG_ACTIVE_LEVEL &&                                            \
+            ELEGANTLOG_UNLIKELY(ElegantLog::Logger::instance().enabled(level)))                              \
+        {                                                                                                    \
+            gate_decl;                                                                                       \
+            if (!(gate))                                                                                     \
+                break;                                                                                       \
+            if (ElegantLog::Logger::instance().binary())                                                     \
+            {                                                                                                \
+                static const uint32_t site_ =                                                                \
+                    ElegantLog::registerSite(level, __FILE__ ":" ELEGANTLOG_STR(__LINE__), __func__, fmt);   \
+                ElegantLog::Logger::instance().logBinary(site_, level, ##__VA_ARGS__);                       \
+            }                                                                                                \
+            else                                                                                             \
+            {                                                                                                \
+                static constexpr ElegantLog::detail::FormatSpec<ElegantLog::detail::countPlaceholders(fmt)> spec_(fmt); \
+                ElegantLog::Logger::instance().logAt(level, __FILE__ ":" ELEGANTLOG_STR(__LINE__), __func__, spec_, ##__VA_ARGS__); \
+            }                                                                                                \
+        }                                                                                                    \
+    } while (0)
+
+#define ELEGANTLOG_LOG(level, fmt, ...) ELEGANTLOG_LOG_IF(level, (void)0, true, fmt, ##__VA_ARGS__)
+
+#define LOG_TRACE(fmt, ...) ELEGANTLOG_LOG(ElegantLog::LogLevel::TRACE, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) ELEGANTLOG_LOG(ElegantLog::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) ELEGANTLOG_LOG(ElegantLog::LogLevel::INFO, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) ELEGANTLOG_LOG(ElegantLog::LogLevel::WARN, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) ELEGANTLOG_LOG(ElegantLog::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define LOG_FATAL(fmt, ...) ELEGANTLOG_LOG(ElegantLog::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
+#define ELEGANTLOG_LOG_EVERY(level, n, fmt, ...) \
+    ELEGANTLOG_LOG_IF(level, static std::atomic<uint64_t> every_{0}, ElegantLog::everyNth(every_, n), fmt, ##__VA_ARGS__)
+#define ELEGANTLOG_LOG_RATE(level, hz, fmt, ...) \
+    ELEGANTLOG_LOG_IF(level, static ElegantLog::RateLimiter rate_(hz), rate_.allow(), fmt, ##__VA_ARGS__)
+
+// 热路径上的日志：每 n 次输出一次
+#define LOG_TRACE_EVERY(n, fmt, ...) ELEGANTLOG_LOG_EVERY(ElegantLog::LogLevel::TRACE, n, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_EVERY(n, fmt, ...) ELEGANTLOG_LOG_EVERY(ElegantLog::LogLevel::DEBUG, n, fmt, ##__VA_ARGS__)
+#define LOG_INFO_EVERY(n, fmt, ...) ELEGANTLOG_LOG_EVERY(ElegantLog::LogLevel::INFO, n, fmt, ##__VA_ARGS__)
+#define LOG_WARN_EVERY(n, fmt, ...) ELEGANTLOG_LOG_EVERY(ElegantLog::LogLevel::WARN, n, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_EVERY(n, fmt, ...) ELEGANTLOG_LOG_EVERY(ElegantLog::LogLevel::ERROR, n, fmt, ##__VA_ARGS__)
+#define LOG_FATAL_EVERY(n, fmt, ...) ELEGANTLOG_LOG_EVERY(ElegantLog::LogLevel::FATAL, n, fmt, ##__VA_ARGS__)
+
+// 热路径上的日志：每秒最多 hz 条
+#define LOG_TRACE_RATE(hz, fmt, ...) ELEGANTLOG_LOG_RATE(ElegantLog::LogLevel::TRACE, hz, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_RATE(hz, fmt, ...) ELEGANTLOG_LOG_RATE(ElegantLog::LogLevel::DEBUG, hz, fmt, ##__VA_ARGS__)
+#define LOG_INFO_RATE(hz, fmt, ...) ELEGANTLOG_LOG_RATE(ElegantLog::LogLevel::INFO, hz, fmt, ##__VA_ARGS__)
+#define LOG_WARN_RATE(hz, fmt, ...) ELEGANTLOG_LOG_RATE(ElegantLog::LogLevel::WARN, hz, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_RATE(hz, fmt, ...) ELEGANTLOG_LOG_RATE(ElegantLog::LogLevel::ERROR, hz, fmt, ##__VA_ARGS__)
+#define LOG_FATAL_RATE(hz, fmt, ...) ELEGANTLOG_LOG_RATE(ElegantLog::LogLevel::FATAL, hz, fmt, ##__VA_ARGS__)
 
     // ==================== 初始化工具 ====================
+    // binary 为 true 时文件写二进制格式（BinaryFileSink），并打开 Logger 的二进制模式
     inline void initDefaultLogger(bool console = true, bool file = false,
-                                  const std::string &filename = "log/myapp.log")
+                                  const std::string &filename = "log/myapp.log", bool binary = false)
     {
         auto &logger = Logger::instance();
         logger.removeAllSinks();
         logger.setLevel(ElegantLog::LogLevel::DEBUG);
+        logger.setBinary(binary);
+        auto fileSink = [&filename, binary]() -> std::shared_ptr<Sink>
+        {
+            if (binary)
+                return std::make_shared<BinaryFileSink>(filename);
+            return std::make_shared<FileSink>(filename);
+        };
 
         if (console)
         {
@@ -514,7 +2114,7 @@ namespace ElegantLog
                     if (mkdir(dir, 0755) == 0)
                     {
                         LOG_ERROR("log 目录创建成功\n");
-                        logger.addSink(std::make_shared<FileSink>(filename));
+                        logger.addSink(fileSink());
                     }
                     else
                     {
@@ -531,7 +2131,7 @@ namespace ElegantLog
                 {
 
                     LOG_INFO("log 目录已存在");
-                    logger.addSink(std::make_shared<FileSink>(filename));
+                    logger.addSink(fileSink());
                 }
             }
             catch (const std::exception &e)
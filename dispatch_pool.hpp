@@ -0,0 +1,184 @@
+#pragma once
+// dispatch_pool.hpp
+// 订阅消息分发线程池：同一个 key（主题）固定落到同一个工作线程，保证顺序；
+// 不同主题并行处理。每个工作线程的队列有上限，满了按策略处理
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class OverflowPolicy
+{
+    BLOCK,       // 阻塞提交方（paho 回调线程），反压到 TCP
+    DROP_NEWEST, // 丢弃新来的
+    DROP_OLDEST  // 丢弃队列里最旧的
+};
+
+struct DispatchStats
+{
+    size_t depth = 0;      // 当前排队总数
+    size_t high_water = 0; // 单个队列出现过的最大深度
+    size_t dropped = 0;
+    size_t processed = 0;
+};
+
+class DispatchPool
+{
+public:
+    using task_type = std::function<void()>;
+
+    /**
+     * @param workers  工作线程数
+     * @param capacity 每个工作线程的队列上限
+     * @param policy   队列满时的处理策略
+     */
+    explicit DispatchPool(size_t workers = 4, size_t capacity = 256, OverflowPolicy policy = OverflowPolicy::BLOCK)
+        : m_capacity(std::max<size_t>(capacity, 1)), m_policy(policy)
+    {
+        workers = std::max<size_t>(workers, 1);
+        for (size_t i = 0; i < workers; ++i)
+            m_shards.emplace_back(new Shard());
+        for (auto &s : m_shards)
+        {
+            Shard *shard = s.get();
+            shard->worker = std::thread([this, shard]
+                                        { work(*shard); });
+        }
+    }
+
+    ~DispatchPool()
+    {
+        stop();
+    }
+
+    // 处理完已排队的任务后退出
+    void stop()
+    {
+        for (auto &s : m_shards)
+        {
+            {
+                std::lock_guard<std::mutex> lock(s->mutex);
+                s->running = false;
+            }
+            s->not_empty.notify_all();
+            s->not_full.notify_all();
+        }
+        for (auto &s : m_shards)
+        {
+            if (s->worker.joinable())
+                s->worker.join();
+        }
+    }
+
+    // 返回 false 表示这条任务被丢弃
+    bool submit(const std::string &key, task_type task)
+    {
+        Shard &s = *m_shards[std::hash<std::string>()(key) % m_shards.size()];
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            if (!s.running)
+                return false;
+            if (s.queue.size() >= m_capacity)
+            {
+                switch (m_policy)
+                {
+                case OverflowPolicy::BLOCK:
+                    s.not_full.wait(lock, [this, &s]
+                                    { return s.queue.size() < m_capacity || !s.running; });
+                    if (!s.running)
+                        return false;
+                    break;
+                case OverflowPolicy::DROP_NEWEST:
+                    ++m_dropped;
+                    return false;
+                case OverflowPolicy::DROP_OLDEST:
+                    s.queue.pop_front();
+                    ++m_dropped;
+                    break;
+                }
+            }
+            s.queue.push_back(std::move(task));
+            size_t depth = s.queue.size();
+            size_t hw = m_high_water.load(std::memory_order_relaxed);
+            while (depth > hw && !m_high_water.compare_exchange_weak(hw, depth, std::memory_order_relaxed))
+            {
+            }
+        }
+        s.not_empty.notify_one();
+        return true;
+    }
+
+    DispatchStats stats()
+    {
+        DispatchStats st;
+        for (auto &s : m_shards)
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            st.depth += s->queue.size();
+        }
+        st.high_water = m_high_water;
+        st.dropped = m_dropped;
+        st.processed = m_processed;
+        return st;
+    }
+
+    // 不加锁，提交路径上用
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    size_t workers() const { return m_shards.size(); }
+
+private:
+    struct Shard
+    {
+        std::deque<task_type> queue;
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        bool running = true;
+        std::thread worker;
+    };
+
+    void work(Shard &s)
+    {
+        while (true)
+        {
+            task_type task;
+            {
+                std::unique_lock<std::mutex> lock(s.mutex);
+                s.not_empty.wait(lock, [&s]
+                                 { return !s.queue.empty() || !s.running; });
+                if (s.queue.empty())
+                    break;
+                task = std::move(s.queue.front());
+                s.queue.pop_front();
+            }
+            s.not_full.notify_one();
+            try
+            {
+                task();
+            }
+            catch (const std::exception &)
+            {
+                // 单条消息处理失败不影响后续消息
+            }
+            catch (...)
+            {
+                // 抛出非 std::exception 的处理函数也不能带走工作线程
+            }
+            ++m_processed;
+        }
+    }
+
+    const size_t m_capacity;
+    const OverflowPolicy m_policy;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<size_t> m_high_water{0};
+    std::atomic<size_t> m_dropped{0};
+    std::atomic<size_t> m_processed{0};
+};
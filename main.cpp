@@ -4,6 +4,10 @@
 #include "publisher.hpp"
 #include "subscriber.hpp"
 #include "serial.hpp"
+#include "modbus_rpc.hpp"
+#include "modbus_gateway.hpp"
+#include "payload_codec.hpp"
+#include "tsz_codec.hpp"
 #include "ElegantLog.hpp"
 
 void signalHandler(int signum){
@@ -15,28 +19,108 @@ int main(int argc, char const *argv[])
 {
     std::signal(SIGINT, signalHandler);
 
-    // 初始化日志系统
-    ElegantLog::initDefaultLogger(true, true, "log/myapp.log");
+    // --format=text|cbor|packed，默认保持文本
+    // --batch=N 攒够 N 个样本后压缩成一个块再发
+    // --v5 使用 MQTT v5（主题别名、会话保留）
+    // --gateway=PORT 把串口总线以 Modbus TCP 从站开放给 SCADA 等其他主站
+    // --binlog 日志文件写二进制格式（log/myapp.blog），用 test/log_decode.cpp 解码
+    PayloadFormat format = PayloadFormat::TEXT;
+    size_t batch = 1;
+    bool v5 = false;
+    bool binlog = false;
+    int gateway_port = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 9, "--format=") == 0 && !parsePayloadFormat(arg.substr(9), format))
+        {
+            std::cerr << "unknown payload format: " << arg.substr(9) << std::endl;
+            return 1;
+        }
+        if (arg == "--v5")
+        {
+            v5 = true;
+        }
+        if (arg == "--binlog")
+        {
+            binlog = true;
+        }
+        if (arg.compare(0, 10, "--gateway=") == 0)
+        {
+            gateway_port = std::atoi(arg.c_str() + 10);
+            if (gateway_port <= 0 || gateway_port > 65535)
+            {
+                std::cerr << "invalid gateway port: " << arg.substr(10) << std::endl;
+                return 1;
+            }
+        }
+        if (arg.compare(0, 8, "--batch=") == 0)
+        {
+            batch = std::strtoul(arg.c_str() + 8, nullptr, 10);
+            if (batch == 0 || batch > tsz::MAX_SAMPLES)
+            {
+                std::cerr << "invalid batch size: " << arg.substr(8) << std::endl;
+                return 1;
+            }
+        }
+    }
 
-    Publisher publisher("broker.emqx.io:1883", "cpp_publisher", "yun/topic");
-    Subscriber subscriber("broker.emqx.io:1883", "cpp_subscriber", "yun/topic");
+    // 初始化日志系统；SD 卡写不动时丢日志计数，不拖住串口和 MQTT 线程。
+    // 容量是每个线程的（每条约 500 字节），十来个打日志的线程合计约 1300 条、650KB
+    ElegantLog::Logger::instance().setQueue(128, ElegantLog::OverflowPolicy::COUNT);
+    ElegantLog::initDefaultLogger(true, true, binlog ? "log/myapp.blog" : "log/myapp.log", binlog);
+    // 连续相同的日志（比如串口一直超时）折叠成一行计数，最多 30 秒报一次
+    ElegantLog::Logger::instance().setRepeatWindow(std::chrono::seconds(30));
+
+    // 串口采集立即开始，和 broker 连接并行进行
     auto &serial = meteserial::instance();
+    // 300ms 内重复的读（RPC、网关上的多个主站）直接从寄存器镜像回
+    serial.cache().setDefaultTtl(std::chrono::milliseconds(300));
     serial.start();
-    std::this_thread::sleep_for(std::chrono::seconds(13)); // 简单休眠
+
+    // 发布和订阅共用一条连接
+    auto conn = std::make_shared<MqttConnection>("broker.emqx.io:1883", "cpp_sen_mqtt", v5);
+    Publisher publisher(conn, "yun/topic");
+    Subscriber subscriber(conn, "yun/topic");
+    // 云端按需读写寄存器，插队到下一次轮询之前
+    ModbusRpc rpc(conn, serial, "yun/rpc");
+    ModbusGateway gateway(serial, static_cast<uint16_t>(gateway_port));
+    if (gateway_port > 0)
+        gateway.start();
     try
     {
-        // Subscribe to the topic and wait for messages
+        // 订阅先登记，连上之后自动发出
         subscriber.subtopic();
+        conn->connectAsync();
 
+        // 就绪：已连上 broker 并且拿到第一帧有效数据
+        // 连接失败和断线由连接的监护线程按退避重连，这里只等
+        while (!serial.waitForData(std::chrono::seconds(1)) || !conn->waitConnected(std::chrono::seconds(1)))
+        {
+            LOG_DEBUG("Waiting for broker connection and first sample...");
+        }
+        LOG_INFO("Ready: broker connected and first sample received");
+
+        TszEncoder batcher(4);
         while (1)
         {
             auto ret = serial.getFloatData();
-            std::string payload = "x: " + std::to_string(ret[0]) +
-                                  ",y: " + std::to_string(ret[1]) +
-                                  ", z: " + std::to_string(ret[2]) +
-                                  ", t: " + std::to_string(ret[3]);
-
-            publisher.publish(payload);
+            if (batch > 1)
+            {
+                auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+                batcher.append(now, ret);
+                if (batcher.count() >= batch)
+                {
+                    publisher.publish(batcher.finish());
+                }
+            }
+            else
+            {
+                std::string payload = PayloadCodec::encodeSample(ret, format);
+                publisher.publish(payload);
+            }
 
             // Publish a message
             std::this_thread::sleep_for(std::chrono::seconds(6)); // 简单休眠
@@ -0,0 +1,362 @@
+#pragma once
+// modbus.hpp
+// Modbus 请求/应答的 PDU 编解码（FC 01/02/03/04/05/06/15/16）和 RTU / TCP(MBAP) 帧封装，与具体总线无关
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "calculate.hpp"
+
+namespace modbus
+{
+    enum Function : uint8_t
+    {
+        READ_COILS = 0x01,
+        READ_DISCRETE_INPUTS = 0x02,
+        READ_HOLDING_REGISTERS = 0x03,
+        READ_INPUT_REGISTERS = 0x04,
+        WRITE_SINGLE_COIL = 0x05,
+        WRITE_SINGLE_REGISTER = 0x06,
+        WRITE_MULTIPLE_COILS = 0x0F,
+        WRITE_MULTIPLE_REGISTERS = 0x10
+    };
+
+    const uint16_t MAX_READ_BITS = 2000;
+    const uint16_t MAX_WRITE_BITS = 1968;
+    const uint16_t MAX_READ_REGISTERS = 125;
+    const uint16_t MAX_WRITE_REGISTERS = 123;
+
+    enum class Status : uint8_t
+    {
+        OK,
+        EXCEPTION, // 从站返回异常码
+        TIMEOUT,
+        BAD_FRAME, // CRC 错、长度不对、地址/功能码对不上
+        INVALID    // 请求本身不合法，没有上总线
+    };
+
+    inline const char *statusToString(Status s)
+    {
+        static const char *names[] = {"ok", "exception", "timeout", "bad_frame", "invalid"};
+        return names[static_cast<size_t>(s)];
+    }
+
+    struct Request
+    {
+        uint8_t slave = 0;
+        uint8_t function = READ_HOLDING_REGISTERS;
+        uint16_t address = 0;
+        uint16_t count = 0;           // 读的寄存器/位数；写时由 values 决定
+        std::vector<uint16_t> values; // 写入的值，线圈非 0 即为 ON
+    };
+
+    struct Response
+    {
+        Status status = Status::TIMEOUT;
+        uint8_t exception = 0;           // status 为 EXCEPTION 时的异常码
+        std::vector<uint16_t> registers; // 读到的寄存器，读线圈/离散输入时每位一个 0/1，写操作为空
+    };
+
+    using Callback = std::function<void(const Response &)>;
+
+    inline bool isWrite(uint8_t function)
+    {
+        return function == WRITE_SINGLE_COIL || function == WRITE_SINGLE_REGISTER ||
+               function == WRITE_MULTIPLE_COILS || function == WRITE_MULTIPLE_REGISTERS;
+    }
+
+    // 按位读写的功能码
+    inline bool isBitFunction(uint8_t function)
+    {
+        return function == READ_COILS || function == READ_DISCRETE_INPUTS ||
+               function == WRITE_SINGLE_COIL || function == WRITE_MULTIPLE_COILS;
+    }
+
+    inline bool validRequest(const Request &req)
+    {
+        switch (req.function)
+        {
+        case READ_COILS:
+        case READ_DISCRETE_INPUTS:
+            return req.count >= 1 && req.count <= MAX_READ_BITS;
+        case READ_HOLDING_REGISTERS:
+        case READ_INPUT_REGISTERS:
+            return req.count >= 1 && req.count <= MAX_READ_REGISTERS;
+        case WRITE_SINGLE_COIL:
+        case WRITE_SINGLE_REGISTER:
+            return req.values.size() == 1;
+        case WRITE_MULTIPLE_COILS:
+            return !req.values.empty() && req.values.size() <= MAX_WRITE_BITS;
+        case WRITE_MULTIPLE_REGISTERS:
+            return !req.values.empty() && req.values.size() <= MAX_WRITE_REGISTERS;
+        default:
+            return false;
+        }
+    }
+
+    inline void putU16(std::vector<uint8_t> &out, uint16_t v)
+    {
+        out.push_back(static_cast<uint8_t>(v >> 8));
+        out.push_back(static_cast<uint8_t>(v & 0xFF));
+    }
+
+    inline uint16_t getU16(const uint8_t *p)
+    {
+        return static_cast<uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    // 功能码 + 数据
+    inline std::vector<uint8_t> encodePdu(const Request &req)
+    {
+        std::vector<uint8_t> pdu;
+        pdu.push_back(req.function);
+        putU16(pdu, req.address);
+        switch (req.function)
+        {
+        case WRITE_SINGLE_COIL:
+            putU16(pdu, req.values[0] ? 0xFF00 : 0x0000);
+            break;
+        case WRITE_SINGLE_REGISTER:
+            putU16(pdu, req.values[0]);
+            break;
+        case WRITE_MULTIPLE_COILS:
+        {
+            // 低位在前打包
+            putU16(pdu, static_cast<uint16_t>(req.values.size()));
+            size_t bytes = (req.values.size() + 7) / 8;
+            pdu.push_back(static_cast<uint8_t>(bytes));
+            size_t base = pdu.size();
+            pdu.resize(base + bytes, 0);
+            for (size_t i = 0; i < req.values.size(); ++i)
+            {
+                if (req.values[i])
+                    pdu[base + i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+            }
+            break;
+        }
+        case WRITE_MULTIPLE_REGISTERS:
+            putU16(pdu, static_cast<uint16_t>(req.values.size()));
+            pdu.push_back(static_cast<uint8_t>(req.values.size() * 2));
+            for (uint16_t v : req.values)
+                putU16(pdu, v);
+            break;
+        default:
+            putU16(pdu, req.count);
+            break;
+        }
+        return pdu;
+    }
+
+    // 正常应答 PDU 的长度
+    inline size_t responsePduLength(const Request &req)
+    {
+        if (isWrite(req.function))
+            return 5;
+        if (isBitFunction(req.function))
+            return 2 + (req.count + 7) / 8;
+        return 2 + req.count * 2;
+    }
+
+    /**
+     * @brief 解析应答 PDU
+     * @param pdu 从功能码开始，不含地址和校验
+     */
+    inline Status decodePdu(const Request &req, const uint8_t *pdu, size_t len, Response &rsp)
+    {
+        rsp.registers.clear();
+        rsp.exception = 0;
+        if (len >= 2 && pdu[0] == (req.function | 0x80))
+        {
+            rsp.exception = pdu[1];
+            return rsp.status = Status::EXCEPTION;
+        }
+        if (len != responsePduLength(req) || pdu[0] != req.function)
+            return rsp.status = Status::BAD_FRAME;
+        if (isWrite(req.function))
+        {
+            // 回显地址和值/数量
+            if (getU16(pdu + 1) != req.address)
+                return rsp.status = Status::BAD_FRAME;
+            return rsp.status = Status::OK;
+        }
+        if (pdu[1] != len - 2)
+            return rsp.status = Status::BAD_FRAME;
+        if (isBitFunction(req.function))
+        {
+            for (size_t i = 0; i < req.count; ++i)
+                rsp.registers.push_back((pdu[2 + i / 8] >> (i % 8)) & 1);
+            return rsp.status = Status::OK;
+        }
+        for (size_t i = 0; i < req.count; ++i)
+            rsp.registers.push_back(getU16(pdu + 2 + i * 2));
+        return rsp.status = Status::OK;
+    }
+
+    // ==================== RTU ====================
+    // 地址 + PDU + CRC（低字节在前）
+    inline std::vector<uint8_t> rtuFrame(const Request &req)
+    {
+        std::vector<uint8_t> frame;
+        frame.push_back(req.slave);
+        auto pdu = encodePdu(req);
+        frame.insert(frame.end(), pdu.begin(), pdu.end());
+        uint16_t crc = modbus_crc16(frame.data(), static_cast<uint16_t>(frame.size()));
+        frame.push_back(static_cast<uint8_t>(crc & 0xFF));
+        frame.push_back(static_cast<uint8_t>(crc >> 8));
+        return frame;
+    }
+
+    inline size_t rtuResponseLength(const Request &req)
+    {
+        return 1 + responsePduLength(req) + 2;
+    }
+
+    // 异常应答固定 5 字节，收到这么多就可以判断了
+    inline bool rtuIsException(const uint8_t *frame, size_t len)
+    {
+        return len >= 2 && (frame[1] & 0x80);
+    }
+
+    inline Status decodeRtu(const Request &req, const uint8_t *frame, size_t len, Response &rsp)
+    {
+        if (len < 5 || modbus_crc16(frame, static_cast<uint16_t>(len)) != 0 || frame[0] != req.slave)
+            return rsp.status = Status::BAD_FRAME;
+        return decodePdu(req, frame + 1, len - 3, rsp);
+    }
+
+    // ==================== TCP ====================
+    // MBAP 头：事务号(2) 协议号(2, 恒为 0) 长度(2, 单元号+PDU) 单元号(1)
+    const size_t MBAP_HEADER_SIZE = 7;
+
+    inline std::vector<uint8_t> tcpFrame(uint16_t tid, const Request &req)
+    {
+        auto pdu = encodePdu(req);
+        std::vector<uint8_t> frame;
+        frame.reserve(MBAP_HEADER_SIZE + pdu.size());
+        putU16(frame, tid);
+        putU16(frame, 0);
+        putU16(frame, static_cast<uint16_t>(pdu.size() + 1));
+        frame.push_back(req.slave);
+        frame.insert(frame.end(), pdu.begin(), pdu.end());
+        return frame;
+    }
+
+    // 缓冲区开头是一帧完整的 MBAP 帧时返回它的长度，不完整返回 0
+    inline size_t tcpFrameLength(const uint8_t *data, size_t len)
+    {
+        if (len < MBAP_HEADER_SIZE)
+            return 0;
+        size_t n = 6 + getU16(data + 4);
+        return len >= n ? n : 0;
+    }
+    // ==================== 从站侧（网关用） ====================
+    // 回给主站的异常码
+    const uint8_t EXCEPTION_ILLEGAL_FUNCTION = 0x01;
+    const uint8_t EXCEPTION_ILLEGAL_DATA_VALUE = 0x03;
+    const uint8_t EXCEPTION_SLAVE_BUSY = 0x06;
+    const uint8_t EXCEPTION_GATEWAY_TARGET_FAILED = 0x0B;
+
+    /**
+     * @brief 解析主站发来的请求 PDU
+     * @return 0 成功，否则为应回给主站的异常码
+     */
+    inline uint8_t decodeRequestPdu(const uint8_t *pdu, size_t len, Request &req)
+    {
+        req.values.clear();
+        req.count = 0;
+        if (len < 5)
+            return EXCEPTION_ILLEGAL_DATA_VALUE;
+        req.function = pdu[0];
+        req.address = getU16(pdu + 1);
+        uint16_t v = getU16(pdu + 3);
+        switch (req.function)
+        {
+        case READ_COILS:
+        case READ_DISCRETE_INPUTS:
+        case READ_HOLDING_REGISTERS:
+        case READ_INPUT_REGISTERS:
+            req.count = v;
+            break;
+        case WRITE_SINGLE_COIL:
+            if (v != 0xFF00 && v != 0x0000)
+                return EXCEPTION_ILLEGAL_DATA_VALUE;
+            req.values.push_back(v ? 1 : 0);
+            break;
+        case WRITE_SINGLE_REGISTER:
+            req.values.push_back(v);
+            break;
+        case WRITE_MULTIPLE_COILS:
+            if (len < 6 || pdu[5] != (v + 7) / 8 || len != 6u + pdu[5])
+                return EXCEPTION_ILLEGAL_DATA_VALUE;
+            for (size_t i = 0; i < v; ++i)
+                req.values.push_back((pdu[6 + i / 8] >> (i % 8)) & 1);
+            break;
+        case WRITE_MULTIPLE_REGISTERS:
+            if (len < 6 || pdu[5] != v * 2 || len != 6u + pdu[5])
+                return EXCEPTION_ILLEGAL_DATA_VALUE;
+            for (size_t i = 0; i < v; ++i)
+                req.values.push_back(getU16(pdu + 6 + i * 2));
+            break;
+        default:
+            return EXCEPTION_ILLEGAL_FUNCTION;
+        }
+        return validRequest(req) ? 0 : EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+
+    inline std::vector<uint8_t> exceptionPdu(uint8_t function, uint8_t code)
+    {
+        return std::vector<uint8_t>{static_cast<uint8_t>(function | 0x80), code};
+    }
+
+    // 按从站的格式回应答 PDU；超时/坏帧回网关异常码
+    inline std::vector<uint8_t> encodeResponsePdu(const Request &req, const Response &rsp)
+    {
+        if (rsp.status == Status::EXCEPTION)
+            return exceptionPdu(req.function, rsp.exception);
+        if (rsp.status != Status::OK)
+            return exceptionPdu(req.function, rsp.status == Status::INVALID ? EXCEPTION_ILLEGAL_DATA_VALUE
+                                                                           : EXCEPTION_GATEWAY_TARGET_FAILED);
+        std::vector<uint8_t> pdu;
+        pdu.push_back(req.function);
+        if (isWrite(req.function))
+        {
+            putU16(pdu, req.address);
+            if (req.function == WRITE_SINGLE_COIL)
+                putU16(pdu, req.values[0] ? 0xFF00 : 0x0000);
+            else if (req.function == WRITE_SINGLE_REGISTER)
+                putU16(pdu, req.values[0]);
+            else
+                putU16(pdu, static_cast<uint16_t>(req.values.size()));
+            return pdu;
+        }
+        if (isBitFunction(req.function))
+        {
+            size_t bytes = (rsp.registers.size() + 7) / 8;
+            pdu.push_back(static_cast<uint8_t>(bytes));
+            pdu.resize(2 + bytes, 0);
+            for (size_t i = 0; i < rsp.registers.size(); ++i)
+            {
+                if (rsp.registers[i])
+                    pdu[2 + i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+            }
+            return pdu;
+        }
+        pdu.push_back(static_cast<uint8_t>(rsp.registers.size() * 2));
+        for (uint16_t r : rsp.registers)
+            putU16(pdu, r);
+        return pdu;
+    }
+
+    // MBAP 应答帧，事务号和单元号照抄请求
+    inline std::vector<uint8_t> tcpResponseFrame(uint16_t tid, uint8_t unit, const std::vector<uint8_t> &pdu)
+    {
+        std::vector<uint8_t> frame;
+        frame.reserve(MBAP_HEADER_SIZE + pdu.size());
+        putU16(frame, tid);
+        putU16(frame, 0);
+        putU16(frame, static_cast<uint16_t>(pdu.size() + 1));
+        frame.push_back(unit);
+        frame.insert(frame.end(), pdu.begin(), pdu.end());
+        return frame;
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+// modbus_cache.hpp
+// 寄存器镜像缓存：按 (从站, 寄存器表, 地址) 存每个点最近读到的值和过期时间，
+// 读请求覆盖的点都还新鲜时直接从镜像回，不上总线。每个点的 TTL 可以单独配置，
+// 写请求让覆盖到的点立即失效
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "modbus.hpp"
+
+namespace modbus
+{
+    // 功能码对应的寄存器表：线圈、离散输入、保持寄存器、输入寄存器
+    inline uint8_t tableOf(uint8_t function)
+    {
+        switch (function)
+        {
+        case WRITE_SINGLE_COIL:
+        case WRITE_MULTIPLE_COILS:
+            return READ_COILS;
+        case WRITE_SINGLE_REGISTER:
+        case WRITE_MULTIPLE_REGISTERS:
+            return READ_HOLDING_REGISTERS;
+        default:
+            return function;
+        }
+    }
+
+    class RegisterCache
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        // 没有单独配置的点用这个 TTL，0 表示不缓存
+        void setDefaultTtl(std::chrono::milliseconds ttl)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            default_ttl_ = ttl;
+        }
+
+        /**
+         * @brief 给一段点单独配置 TTL（比如慢变的配置参数给几秒，报警点给 0）
+         * @param function 读这段点用的功能码（01/02/03/04）
+         * 后配置的覆盖先配置的
+         */
+        void setTtl(uint8_t slave, uint8_t function, uint16_t address, uint16_t count, std::chrono::milliseconds ttl)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rules_.push_back({slave, tableOf(function), address, static_cast<uint32_t>(address) + count, ttl});
+        }
+
+        // 读请求的每个点都在且没过期时填好 rsp 返回 true
+        bool lookup(const Request &req, Response &rsp)
+        {
+            if (isWrite(req.function) || !validRequest(req))
+                return false;
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto image = images_.find(imageKey(req.slave, req.function));
+            if (image == images_.end())
+                return false;
+            auto now = clock::now();
+            auto it = image->second.find(req.address);
+            std::vector<uint16_t> values;
+            values.reserve(req.count);
+            for (uint32_t addr = req.address; addr < static_cast<uint32_t>(req.address) + req.count; ++addr, ++it)
+            {
+                // 地址连续存放，按顺序往后走就行
+                if (it == image->second.end() || it->first != addr || it->second.expires <= now)
+                    return false;
+                values.push_back(it->second.value);
+            }
+            rsp.status = Status::OK;
+            rsp.exception = 0;
+            rsp.registers.swap(values);
+            ++hits_;
+            return true;
+        }
+
+        // 读成功后把结果写进镜像
+        void store(const Request &req, const Response &rsp)
+        {
+            if (isWrite(req.function) || rsp.status != Status::OK || rsp.registers.size() != req.count)
+                return;
+            std::lock_guard<std::mutex> lock(mutex_);
+            uint8_t table = tableOf(req.function);
+            auto now = clock::now();
+            auto &image = images_[imageKey(req.slave, req.function)];
+            for (size_t i = 0; i < req.count; ++i)
+            {
+                uint16_t addr = static_cast<uint16_t>(req.address + i);
+                auto ttl = ttlFor(req.slave, table, addr);
+                if (ttl.count() <= 0)
+                {
+                    image.erase(addr);
+                    continue;
+                }
+                image[addr] = Point{rsp.registers[i], now + ttl};
+            }
+        }
+
+        // 写请求覆盖到的点作废（提交时和完成时各调一次）
+        void invalidate(const Request &req)
+        {
+            if (!isWrite(req.function))
+                return;
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto image = images_.find(imageKey(req.slave, req.function));
+            if (image == images_.end())
+                return;
+            uint32_t end = static_cast<uint32_t>(req.address) + req.values.size();
+            image->second.erase(image->second.lower_bound(req.address),
+                                end > 0xFFFF ? image->second.end() : image->second.lower_bound(static_cast<uint16_t>(end)));
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            images_.clear();
+        }
+
+        uint64_t hits()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return hits_;
+        }
+
+    private:
+        struct Point
+        {
+            uint16_t value;
+            clock::time_point expires;
+        };
+
+        struct Rule
+        {
+            uint8_t slave;
+            uint8_t table;
+            uint32_t begin;
+            uint32_t end;
+            std::chrono::milliseconds ttl;
+        };
+
+        static uint16_t imageKey(uint8_t slave, uint8_t function)
+        {
+            return static_cast<uint16_t>(slave << 8 | tableOf(function));
+        }
+
+        std::chrono::milliseconds ttlFor(uint8_t slave, uint8_t table, uint16_t addr) const
+        {
+            for (auto it = rules_.rbegin(); it != rules_.rend(); ++it)
+            {
+                if (it->slave == slave && it->table == table && addr >= it->begin && addr < it->end)
+                    return it->ttl;
+            }
+            return default_ttl_;
+        }
+
+        std::chrono::milliseconds default_ttl_{0};
+        std::vector<Rule> rules_;
+        std::map<uint16_t, std::map<uint16_t, Point>> images_;
+        uint64_t hits_ = 0;
+        std::mutex mutex_;
+    };
+}
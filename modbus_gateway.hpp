@@ -0,0 +1,464 @@
+#pragma once
+// modbus_gateway.hpp
+// 把一条 Modbus 总线（通常是 RS485 RTU）以 Modbus TCP 从站的形式开放给多个主站（SCADA 等）
+// - 每个客户端一个请求队列，轮流上总线，一个客户端刷请求不会饿死别人
+// - 同一时刻完全相同的读请求只上一次总线，结果分给所有等待者
+// - 读请求先查总线的寄存器镜像缓存（RegisterCache，TTL 在总线上配置）
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ElegantLog.hpp"
+#include "modbus_scheduler.hpp"
+
+struct GatewayStats
+{
+    uint64_t requests = 0;   // 收到的请求
+    uint64_t bus = 0;        // 实际上总线的事务
+    uint64_t merged = 0;     // 合并到在途读请求上的
+    uint64_t cache_hits = 0; // 直接从寄存器镜像回的
+    uint64_t rejected = 0;   // 队列满、请求不合法
+};
+
+class ModbusGateway
+{
+public:
+    /**
+     * @param port        监听端口，0 表示随机（测试用）
+     * @param bus_window  网关同时压在总线队列里的事务数，留出空位给轮询和 RPC
+     * @param queue_limit 每个客户端最多排队的请求数，超出回异常码 6（从站忙）
+     */
+    ModbusGateway(modbus::Master &bus, uint16_t port = 502, size_t bus_window = 2, size_t queue_limit = 64)
+        : bus_(bus), port_(port), bus_window_(std::max<size_t>(bus_window, 1)),
+          queue_limit_(queue_limit), done_(std::make_shared<DoneQueue>()) {}
+
+    ~ModbusGateway()
+    {
+        stop();
+    }
+
+    // 监听失败返回 false
+    bool start()
+    {
+        lfd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(lfd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port_);
+        if (lfd_ < 0 || bind(lfd_, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd_, 16) < 0)
+        {
+            LOG_ERROR("Modbus gateway: cannot listen on port {}: {}", port_, strerror(errno));
+            if (lfd_ >= 0)
+                close(lfd_);
+            lfd_ = -1;
+            return false;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(lfd_, (struct sockaddr *)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        done_->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        watch(lfd_, LISTEN_ID, EPOLLIN, EPOLL_CTL_ADD);
+        watch(done_->evfd, EVENT_ID, EPOLLIN, EPOLL_CTL_ADD);
+        running_ = true;
+        worker_ = std::thread(&ModbusGateway::run, this);
+        LOG_INFO("Modbus gateway listening on port {}", port_);
+        return true;
+    }
+
+    void stop()
+    {
+        if (!running_)
+            return;
+        running_ = false;
+        done_->notify();
+        if (worker_.joinable())
+            worker_.join();
+        for (auto &c : clients_)
+            close(c.second.fd);
+        clients_.clear();
+        close(lfd_);
+        close(epfd_);
+        // 总线上还没回来的事务回调时不再碰这个对象
+        std::lock_guard<std::mutex> lock(done_->mutex);
+        close(done_->evfd);
+        done_->evfd = -1;
+    }
+
+    uint16_t port() const { return port_; }
+
+    GatewayStats stats()
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        return stats_;
+    }
+
+private:
+    static const uint64_t LISTEN_ID = 0;
+    static const uint64_t EVENT_ID = 1;
+    // 客户端只发不收时：待发应答超过 OUT_PAUSE 先停止读它的请求，超过 OUT_LIMIT 断开
+    static const size_t OUT_PAUSE = 16 * 1024;
+    static const size_t OUT_LIMIT = 256 * 1024;
+    static const size_t IN_BATCH = 4096;
+
+    // 一个客户端的一个请求
+    struct Pending
+    {
+        uint64_t client;
+        uint16_t tid;
+        uint8_t unit;
+        modbus::Request req;
+    };
+
+    struct Client
+    {
+        int fd;
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        std::deque<Pending> queue;
+        uint32_t interest = EPOLLIN;
+    };
+
+    // 总线线程把结果放这里，网关线程取走；网关先析构时 evfd 置 -1
+    struct DoneQueue
+    {
+        std::mutex mutex;
+        std::vector<std::pair<std::string, modbus::Response>> items;
+        int evfd = -1;
+
+        void push(const std::string &key, const modbus::Response &rsp)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (evfd < 0)
+                return;
+            items.emplace_back(key, rsp);
+            notifyLocked();
+        }
+        void notify()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            notifyLocked();
+        }
+        void notifyLocked()
+        {
+            if (evfd < 0)
+                return;
+            uint64_t one = 1;
+            ssize_t r = write(evfd, &one, sizeof(one));
+            (void)r;
+        }
+    };
+
+    // 相同的读合并成一个 key
+    static std::string readKey(const modbus::Request &req)
+    {
+        return std::to_string(req.slave) + ":" + std::to_string(req.function) + ":" +
+               std::to_string(req.address) + ":" + std::to_string(req.count);
+    }
+
+    void watch(int fd, uint64_t id, uint32_t events, int op)
+    {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.u64 = id;
+        epoll_ctl(epfd_, op, fd, &ev);
+    }
+
+    void run()
+    {
+        std::vector<struct epoll_event> events(32);
+        while (running_)
+        {
+            int n = epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), 1000);
+            for (int i = 0; i < n; ++i)
+            {
+                uint64_t id = events[i].data.u64;
+                if (id == LISTEN_ID)
+                    accept();
+                else if (id == EVENT_ID)
+                {
+                    uint64_t v;
+                    while (read(done_->evfd, &v, sizeof(v)) > 0)
+                    {
+                    }
+                }
+                else
+                    clientEvent(id, events[i].events);
+            }
+            completed();
+            dispatch();
+            flushAll();
+        }
+    }
+
+    void accept()
+    {
+        while (true)
+        {
+            int fd = accept4(lfd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            uint64_t id = next_client_++;
+            clients_[id].fd = fd;
+            watch(fd, id, EPOLLIN, EPOLL_CTL_ADD);
+            LOG_INFO("Modbus gateway: client {} connected ({} total)", id, clients_.size());
+        }
+    }
+
+    void drop(uint64_t id)
+    {
+        auto it = clients_.find(id);
+        if (it == clients_.end())
+            return;
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        close(it->second.fd);
+        clients_.erase(it);
+        LOG_INFO("Modbus gateway: client {} disconnected", id);
+    }
+
+    void clientEvent(uint64_t id, uint32_t events)
+    {
+        auto it = clients_.find(id);
+        if (it == clients_.end())
+            return;
+        Client &c = it->second;
+        if (events & (EPOLLERR | EPOLLHUP))
+        {
+            drop(id);
+            return;
+        }
+        if (!(events & EPOLLIN))
+            return;
+        // 每轮最多读 IN_BATCH，剩下的等下一轮 epoll；应答积压时 flushAll 会停掉 EPOLLIN
+        uint8_t buf[1024];
+        while (c.in.size() < IN_BATCH)
+        {
+            ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+            {
+                drop(id);
+                return;
+            }
+            if (n < 0)
+                break;
+            c.in.insert(c.in.end(), buf, buf + n);
+        }
+
+        size_t off = 0, len;
+        while ((len = modbus::tcpFrameLength(c.in.data() + off, c.in.size() - off)) != 0)
+        {
+            const uint8_t *f = c.in.data() + off;
+            if (len < modbus::MBAP_HEADER_SIZE + 1 || modbus::getU16(f + 2) != 0)
+            {
+                LOG_WARN("Modbus gateway: bad MBAP header from client {}", id);
+                drop(id);
+                return;
+            }
+            Pending p;
+            p.client = id;
+            p.tid = modbus::getU16(f);
+            p.unit = f[6];
+            p.req.slave = p.unit;
+            uint8_t code = modbus::decodeRequestPdu(f + modbus::MBAP_HEADER_SIZE, len - modbus::MBAP_HEADER_SIZE, p.req);
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                ++stats_.requests;
+                if (code == 0 && c.queue.size() >= queue_limit_)
+                    code = modbus::EXCEPTION_SLAVE_BUSY;
+                if (code != 0)
+                    ++stats_.rejected;
+            }
+            if (code != 0)
+                reply(c, p, modbus::exceptionPdu(f[modbus::MBAP_HEADER_SIZE], code));
+            else
+                c.queue.push_back(p);
+            off += len;
+        }
+        c.in.erase(c.in.begin(), c.in.begin() + off);
+    }
+
+    // 轮流从各客户端队列取一个，直到总线窗口占满
+    void dispatch()
+    {
+        while (outstanding_ < bus_window_)
+        {
+            Pending p;
+            if (!nextFair(p))
+                return;
+
+            if (modbus::isWrite(p.req.function))
+            {
+                submit("w" + std::to_string(++write_seq_), p);
+                continue;
+            }
+
+            modbus::Response cached;
+            if (bus_.cache().lookup(p.req, cached))
+            {
+                countStat(&GatewayStats::cache_hits);
+                replyTo(p, cached);
+                continue;
+            }
+            std::string key = readKey(p.req);
+            auto running = inflight_.find(key);
+            if (running != inflight_.end())
+            {
+                countStat(&GatewayStats::merged);
+                running->second.push_back(p);
+                continue;
+            }
+            submit(key, p);
+        }
+    }
+
+    bool nextFair(Pending &p)
+    {
+        if (clients_.empty())
+            return false;
+        auto it = clients_.upper_bound(last_client_);
+        for (size_t i = 0; i < clients_.size(); ++i, ++it)
+        {
+            if (it == clients_.end())
+                it = clients_.begin();
+            if (!it->second.queue.empty())
+            {
+                p = std::move(it->second.queue.front());
+                it->second.queue.pop_front();
+                last_client_ = it->first;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void submit(const std::string &key, const Pending &p)
+    {
+        inflight_[key].push_back(p);
+        ++outstanding_;
+        countStat(&GatewayStats::bus);
+        std::shared_ptr<DoneQueue> done = done_;
+        bus_.submit(p.req, [done, key](const modbus::Response &rsp)
+                    { done->push(key, rsp); });
+    }
+
+    // 总线结果回来，回给所有等这个结果的客户端（缓存由总线自己更新）
+    void completed()
+    {
+        std::vector<std::pair<std::string, modbus::Response>> items;
+        {
+            std::lock_guard<std::mutex> lock(done_->mutex);
+            items.swap(done_->items);
+        }
+        for (auto &item : items)
+        {
+            --outstanding_;
+            auto it = inflight_.find(item.first);
+            if (it == inflight_.end())
+                continue;
+            std::vector<Pending> waiters = std::move(it->second);
+            inflight_.erase(it);
+            for (auto &w : waiters)
+                replyTo(w, item.second);
+        }
+    }
+
+    void replyTo(const Pending &p, const modbus::Response &rsp)
+    {
+        auto it = clients_.find(p.client);
+        if (it != clients_.end())
+            reply(it->second, p, modbus::encodeResponsePdu(p.req, rsp));
+    }
+
+    void reply(Client &c, const Pending &p, const std::vector<uint8_t> &pdu)
+    {
+        auto frame = modbus::tcpResponseFrame(p.tid, p.unit, pdu);
+        c.out.insert(c.out.end(), frame.begin(), frame.end());
+    }
+
+    void flushAll()
+    {
+        std::vector<uint64_t> dead;
+        for (auto &entry : clients_)
+        {
+            Client &c = entry.second;
+            while (!c.out.empty())
+            {
+                ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+                if (n < 0)
+                {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        dead.push_back(entry.first);
+                    break;
+                }
+                c.out.erase(c.out.begin(), c.out.begin() + n);
+            }
+            if (c.out.size() > OUT_LIMIT)
+            {
+                LOG_WARN("Modbus gateway: client {} is not reading replies ({} bytes pending), closing", entry.first,
+                         c.out.size());
+                dead.push_back(entry.first);
+                continue;
+            }
+            // 应答积压时不再收新请求，TCP 窗口把客户端压住
+            uint32_t want = c.out.size() >= OUT_PAUSE ? 0u : static_cast<uint32_t>(EPOLLIN);
+            if (!c.out.empty())
+                want |= EPOLLOUT;
+            if (want != c.interest)
+            {
+                watch(c.fd, entry.first, want, EPOLL_CTL_MOD);
+                c.interest = want;
+            }
+        }
+        for (uint64_t id : dead)
+            drop(id);
+    }
+
+    void countStat(uint64_t GatewayStats::*field)
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        ++(stats_.*field);
+    }
+
+    modbus::Master &bus_;
+    uint16_t port_;
+    size_t bus_window_;
+    size_t queue_limit_;
+
+    int lfd_ = -1;
+    int epfd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+    std::shared_ptr<DoneQueue> done_;
+
+    // 以下只在网关线程里访问
+    std::map<uint64_t, Client> clients_;
+    uint64_t next_client_ = 2;
+    uint64_t last_client_ = 0;
+    std::map<std::string, std::vector<Pending>> inflight_;
+    size_t outstanding_ = 0;
+    uint64_t write_seq_ = 0;
+
+    std::mutex stats_mutex_;
+    GatewayStats stats_;
+};
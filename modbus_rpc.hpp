@@ -0,0 +1,153 @@
+#pragma once
+// modbus_rpc.hpp
+// 云端通过 MQTT 请求/应答触发即时的 Modbus 读写
+//
+// 请求发到 <base>/req/<id>，载荷是空格分隔的 key=value：
+//   slave=1 fc=3 addr=0 count=8
+//   slave=1 fc=6 addr=10 value=100
+//   slave=1 fc=16 addr=10 values=1,2,3
+// 应答：status=ok values=1,2,3 / status=exception code=2 / status=invalid error=...
+// v5 请求带了 Response Topic 就回到那里并原样带回 Correlation Data，
+// 否则（v3）回到 <base>/res/<id>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "ElegantLog.hpp"
+#include "modbus.hpp"
+#include "mqtt_connection.hpp"
+#include "modbus_scheduler.hpp"
+
+class ModbusRpc
+{
+public:
+    ModbusRpc(std::shared_ptr<MqttConnection> connection, modbus::Master &bus, std::string base = "yun/rpc")
+        : BASE_TOPIC(base), conn(connection), bus_(bus)
+    {
+        std::string filter = BASE_TOPIC + "/req/+";
+        handler_id = conn->addMessageHandler(filter, [this](mqtt::const_message_ptr msg)
+                                             { handle(msg); });
+        conn->subscribe(filter, 1);
+    }
+    ~ModbusRpc()
+    {
+        conn->removeMessageHandler(handler_id);
+    }
+
+    static bool parseRequest(const std::string &text, modbus::Request &req, std::string &error)
+    {
+        req = modbus::Request();
+        std::istringstream in(text);
+        std::string token;
+        bool has_fc = false;
+        while (in >> token)
+        {
+            size_t eq = token.find('=');
+            if (eq == std::string::npos)
+            {
+                error = "bad token " + token;
+                return false;
+            }
+            std::string key = token.substr(0, eq);
+            std::string value = token.substr(eq + 1);
+            char *end = nullptr;
+            if (key == "values" || key == "value")
+            {
+                std::istringstream list(value);
+                std::string item;
+                while (std::getline(list, item, ','))
+                {
+                    unsigned long v = std::strtoul(item.c_str(), &end, 0);
+                    if (item.empty() || *end != '\0' || v > 0xFFFF)
+                    {
+                        error = "bad value " + item;
+                        return false;
+                    }
+                    req.values.push_back(static_cast<uint16_t>(v));
+                }
+                continue;
+            }
+            unsigned long v = std::strtoul(value.c_str(), &end, 0);
+            bool is_byte = key == "slave" || key == "fc";
+            if (value.empty() || *end != '\0' || v > (is_byte ? 0xFFu : 0xFFFFu))
+            {
+                error = "bad number for " + key;
+                return false;
+            }
+            if (key == "slave")
+                req.slave = static_cast<uint8_t>(v);
+            else if (key == "fc")
+            {
+                req.function = static_cast<uint8_t>(v);
+                has_fc = true;
+            }
+            else if (key == "addr")
+                req.address = static_cast<uint16_t>(v);
+            else if (key == "count")
+                req.count = static_cast<uint16_t>(v);
+            else
+            {
+                error = "unknown key " + key;
+                return false;
+            }
+        }
+        if (!has_fc || !modbus::validRequest(req))
+        {
+            error = "unsupported request";
+            return false;
+        }
+        return true;
+    }
+
+    static std::string formatResponse(const modbus::Response &rsp)
+    {
+        std::string out = std::string("status=") + modbus::statusToString(rsp.status);
+        if (rsp.status == modbus::Status::EXCEPTION)
+            out += " code=" + std::to_string(rsp.exception);
+        if (!rsp.registers.empty())
+        {
+            out += " values=";
+            for (size_t i = 0; i < rsp.registers.size(); ++i)
+                out += (i ? "," : "") + std::to_string(rsp.registers[i]);
+        }
+        return out;
+    }
+
+private:
+    // paho 回调线程里只解析和入队，应答在串口线程完成后异步发出
+    void handle(mqtt::const_message_ptr msg)
+    {
+        const std::string &topic = msg->get_topic();
+        std::string id = topic.substr(topic.rfind('/') + 1);
+        std::string reply = BASE_TOPIC + "/res/" + id;
+        mqtt::properties props;
+        const mqtt::properties &in = msg->get_properties();
+        if (in.contains(mqtt::property::RESPONSE_TOPIC))
+            reply = mqtt::get<std::string>(in, mqtt::property::RESPONSE_TOPIC);
+        if (in.contains(mqtt::property::CORRELATION_DATA))
+            props.add(mqtt::property(mqtt::property::CORRELATION_DATA,
+                                     mqtt::get<std::string>(in, mqtt::property::CORRELATION_DATA)));
+
+        auto connection = conn;
+        auto respond = [connection, reply, props](const modbus::Response &rsp)
+        {
+            // 控制应答和告警一样走最高优先级通道
+            connection->publish(reply, formatResponse(rsp), 1, false, Lane::ALARM, props);
+        };
+
+        modbus::Request req;
+        std::string error;
+        if (!parseRequest(msg->get_payload_str(), req, error))
+        {
+            LOG_WARN("Bad RPC request on {}: {}", topic, error);
+            connection->publish(reply, "status=invalid error=" + error, 1, false, Lane::ALARM, props);
+            return;
+        }
+        LOG_INFO("RPC {}: slave {} fc {} addr {}", id, static_cast<int>(req.slave), static_cast<int>(req.function), req.address);
+        bus_.submit(req, respond);
+    }
+
+    std::string BASE_TOPIC;
+    std::shared_ptr<MqttConnection> conn;
+    modbus::Master &bus_;
+    int handler_id;
+};
@@ -0,0 +1,330 @@
+#pragma once
+// modbus_scheduler.hpp
+// Modbus 事务调度：按需请求和周期轮询共用一个优先级队列，总线（RTU 串口或 TCP 连接）
+// 空闲时取下一个事务。写 > 按需读 > 轮询，同优先级先来先走；
+// 轮询拖过一个周期还没轮到时提到最前，按需读一直不断也饿不死轮询
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "modbus.hpp"
+#include "modbus_cache.hpp"
+
+namespace modbus
+{
+    enum class Priority : uint8_t
+    {
+        WRITE,
+        REQUEST,
+        POLL
+    };
+    const size_t PRIORITY_COUNT = 3;
+
+    struct Transaction
+    {
+        Request request;
+        Priority priority;
+        Callback done;
+        std::chrono::steady_clock::time_point deadline; ///< 轮询用：过了这个时间提到最前
+    };
+
+    // 没指定优先级时写操作自动插到最前
+    inline Priority defaultPriority(const Request &req)
+    {
+        return isWrite(req.function) ? Priority::WRITE : Priority::REQUEST;
+    }
+
+    class Scheduler
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * @brief 提交一个事务，不阻塞；done 在总线线程里调用
+         * 请求不合法时立即以 INVALID 回调
+         */
+        void submit(const Request &req, Callback done, Priority prio)
+        {
+            if (!validRequest(req))
+            {
+                Response rsp;
+                rsp.status = Status::INVALID;
+                if (done)
+                    done(rsp);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queues_[index(prio)].push_back({req, prio, std::move(done), clock::time_point::max()});
+            }
+            wake();
+        }
+
+        void submit(const Request &req, Callback done)
+        {
+            submit(req, std::move(done), defaultPriority(req));
+        }
+
+        std::future<Response> submit(const Request &req, Priority prio)
+        {
+            auto promise = std::make_shared<std::promise<Response>>();
+            std::future<Response> result = promise->get_future();
+            submit(req, [promise](const Response &rsp)
+                   { promise->set_value(rsp); },
+                   prio);
+            return result;
+        }
+
+        std::future<Response> submit(const Request &req)
+        {
+            return submit(req, defaultPriority(req));
+        }
+
+        /**
+         * @brief 登记一个周期轮询，第一次立即执行
+         * 上一次还没执行完时不会重复入队，总线忙时轮询自然变稀
+         * @return 句柄，用于 removePoll
+         */
+        int addPoll(const Request &req, clock::duration period, Callback done)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto poll = std::make_shared<Poll>();
+            poll->id = ++next_poll_id_;
+            poll->request = req;
+            poll->period = period;
+            poll->due = clock::now();
+            poll->done = std::move(done);
+            polls_.push_back(poll);
+            wakeLocked();
+            return poll->id;
+        }
+
+        void removePoll(int id)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            polls_.erase(std::remove_if(polls_.begin(), polls_.end(),
+                                        [id](const std::shared_ptr<Poll> &p)
+                                        { return p->id == id; }),
+                         polls_.end());
+        }
+
+        /**
+         * @brief 总线线程取下一个事务，没有就等到最早的轮询到期或者有新请求
+         * @return false 表示已停止
+         */
+        bool next(Transaction &t)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (running_)
+            {
+                auto now = clock::now();
+                auto until = schedulePolls(now);
+                if (popLocked(t, now))
+                    return true;
+                cv_.wait_until(lock, until);
+            }
+            return false;
+        }
+
+        // 不等待，取不到返回 false（流水线传输一次取多个时用）
+        bool tryNext(Transaction &t)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto now = clock::now();
+            schedulePolls(now);
+            return running_ && popLocked(t, now);
+        }
+
+        // 下一次轮询到期的时间，没有轮询时为一个较远的时间
+        clock::time_point nextDue()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return schedulePolls(clock::now());
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_ = false;
+            }
+            wake();
+        }
+
+        // 总线线程不在 next() 里等（比如在 epoll_wait）时，用它来唤醒
+        void setNotify(std::function<void()> notify)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            notify_ = std::move(notify);
+        }
+
+        size_t pending()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t n = 0;
+            for (const auto &q : queues_)
+                n += q.size();
+            return n;
+        }
+
+    private:
+        struct Poll
+        {
+            int id = 0;
+            Request request;
+            clock::duration period;
+            clock::time_point due;
+            Callback done;
+            bool queued = false;
+        };
+
+        static size_t index(Priority p) { return static_cast<size_t>(p); }
+
+        void wake()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeLocked();
+        }
+        void wakeLocked()
+        {
+            cv_.notify_all();
+            if (notify_)
+                notify_();
+        }
+
+        bool popLocked(Transaction &t, clock::time_point now)
+        {
+            auto &polls = queues_[index(Priority::POLL)];
+            if (!polls.empty() && polls.front().deadline <= now)
+            {
+                t = std::move(polls.front());
+                polls.pop_front();
+                return true;
+            }
+            for (auto &q : queues_)
+            {
+                if (!q.empty())
+                {
+                    t = std::move(q.front());
+                    q.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 把到期的轮询放进队列，返回最早的下次到期时间
+        clock::time_point schedulePolls(clock::time_point now)
+        {
+            clock::time_point earliest = now + std::chrono::hours(1);
+            for (auto &p : polls_)
+            {
+                if (!p->queued && p->due <= now)
+                {
+                    p->queued = true;
+                    // 落后太多时不补，从现在起重新计
+                    p->due = p->due + p->period > now ? p->due + p->period : now + p->period;
+                    std::weak_ptr<Poll> weak = p;
+                    // 到下一次该轮询时还没轮到就提前
+                    queues_[index(Priority::POLL)].push_back(
+                        {p->request, Priority::POLL, [this, weak](const Response &rsp)
+                         {
+                             auto poll = weak.lock();
+                             if (!poll)
+                                 return;
+                             {
+                                 std::lock_guard<std::mutex> lock(mutex_);
+                                 poll->queued = false;
+                             }
+                             if (poll->done)
+                                 poll->done(rsp);
+                             wake();
+                         },
+                         p->due});
+                }
+                if (!p->queued)
+                    earliest = std::min(earliest, p->due);
+            }
+            return earliest;
+        }
+
+        std::deque<Transaction> queues_[PRIORITY_COUNT];
+        std::vector<std::shared_ptr<Poll>> polls_;
+        int next_poll_id_ = 0;
+        bool running_ = true;
+        std::function<void()> notify_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+    };
+
+    /**
+     * @brief 一条 Modbus 总线（RTU 串口、TCP 连接）对外的事务接口
+     * 具体传输在自己的线程里从 sched_ 取事务执行并回调。
+     * 读请求先查寄存器镜像缓存，命中时在调用线程里直接回调，不上总线
+     */
+    class Master
+    {
+    public:
+        virtual ~Master() {}
+
+        // 不阻塞；done 在总线线程里调用。没指定优先级时写 > 按需读 > 轮询
+        void submit(const Request &req, Callback done, Priority prio)
+        {
+            Response cached;
+            if (cache_.lookup(req, cached))
+            {
+                if (done)
+                    done(cached);
+                return;
+            }
+            // 写：提交时就让旧值失效，避免排在它后面的读拿到旧镜像
+            cache_.invalidate(req);
+            sched_.submit(req, [this, req, done](const Response &rsp)
+                          {
+                if (isWrite(req.function))
+                    cache_.invalidate(req);
+                else
+                    cache_.store(req, rsp);
+                if (done)
+                    done(rsp); },
+                          prio);
+        }
+        void submit(const Request &req, Callback done)
+        {
+            submit(req, std::move(done), defaultPriority(req));
+        }
+        std::future<Response> submit(const Request &req)
+        {
+            auto promise = std::make_shared<std::promise<Response>>();
+            std::future<Response> result = promise->get_future();
+            submit(req, [promise](const Response &rsp)
+                   { promise->set_value(rsp); });
+            return result;
+        }
+
+        // 周期轮询，和按需请求共用队列；轮询结果同样刷新缓存
+        int addPoll(const Request &req, std::chrono::milliseconds period, Callback done)
+        {
+            return sched_.addPoll(req, period, [this, req, done](const Response &rsp)
+                                  {
+                cache_.store(req, rsp);
+                if (done)
+                    done(rsp); });
+        }
+        void removePoll(int id)
+        {
+            sched_.removePoll(id);
+        }
+
+        RegisterCache &cache() { return cache_; }
+
+    protected:
+        RegisterCache cache_;
+        Scheduler sched_;
+    };
+}
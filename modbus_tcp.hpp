@@ -0,0 +1,362 @@
+#pragma once
+// modbus_tcp.hpp
+// Modbus TCP 主站：和 RTU 共用事务调度（modbus::Master），一条连接上最多同时挂
+// max_outstanding 个请求，按 MBAP 事务号匹配应答。单线程 epoll，非阻塞
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ElegantLog.hpp"
+#include "modbus_scheduler.hpp"
+
+class ModbusTcpClient : public modbus::Master
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @param max_outstanding 同时在途的请求数，1 即退化成一问一答
+     * @param timeout         单个请求等应答的时间
+     */
+    ModbusTcpClient(std::string host, uint16_t port = 502, size_t max_outstanding = 8,
+                    std::chrono::milliseconds timeout = std::chrono::milliseconds(1000))
+        : host_(host), port_(port), max_outstanding_(std::max<size_t>(max_outstanding, 1)), timeout_(timeout)
+    {
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        evfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = evfd_;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, evfd_, &ev);
+        int evfd = evfd_;
+        sched_.setNotify([evfd]
+                         {
+            uint64_t one = 1;
+            ssize_t r = write(evfd, &one, sizeof(one));
+            (void)r; });
+    }
+
+    ~ModbusTcpClient()
+    {
+        stop();
+        sched_.stop();
+        sched_.setNotify(nullptr);
+        closeSocket("shutdown");
+        close(evfd_);
+        close(epfd_);
+    }
+
+    void start()
+    {
+        retry_at_ = clock::time_point(); // 立即连，不等上次 stop 留下的重连间隔
+        running_ = true;
+        worker_ = std::thread(&ModbusTcpClient::run, this);
+    }
+
+    // 只停工作线程，排队的请求留着，之后可以再 start()
+    void stop()
+    {
+        running_ = false;
+        uint64_t one = 1;
+        ssize_t r = write(evfd_, &one, sizeof(one));
+        (void)r;
+        if (worker_.joinable())
+            worker_.join();
+    }
+
+    bool isConnected() const { return connected_; }
+
+private:
+    struct Inflight
+    {
+        modbus::Transaction t;
+        clock::time_point deadline;
+    };
+
+    void run()
+    {
+        std::vector<struct epoll_event> events(4);
+        while (running_)
+        {
+            auto now = clock::now();
+            if (sock_ < 0 && now >= retry_at_)
+                startConnect();
+            if (connected_)
+                fill(now);
+            else if (sock_ < 0)
+                failQueued();
+            flush();
+            expire(now);
+
+            // 等到最早的轮询、超时或重连时间
+            auto until = sched_.nextDue();
+            for (const auto &f : inflight_)
+                until = std::min(until, f.second.deadline);
+            if (sock_ < 0)
+                until = std::min(until, retry_at_);
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(until - clock::now()).count();
+            int timeout = static_cast<int>(std::max<long long>(0, std::min<long long>(wait + 1, 1000)));
+
+            updateInterest();
+            int n = epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), timeout);
+            for (int i = 0; i < n; ++i)
+            {
+                if (events[i].data.fd == evfd_)
+                {
+                    uint64_t v;
+                    while (read(evfd_, &v, sizeof(v)) > 0)
+                    {
+                    }
+                    continue;
+                }
+                if (events[i].data.fd != sock_)
+                    continue;
+                if (connecting_ && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+                {
+                    finishConnect();
+                    continue;
+                }
+                if (events[i].events & EPOLLIN)
+                    readable();
+                if (sock_ >= 0 && (events[i].events & (EPOLLERR | EPOLLHUP)))
+                    closeSocket("connection reset");
+            }
+        }
+        closeSocket("stopped");
+    }
+
+    void startConnect()
+    {
+        retry_at_ = clock::now() + std::chrono::seconds(1);
+        struct addrinfo hints, *res = nullptr;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &res) != 0 || !res)
+        {
+            LOG_ERROR("Modbus TCP: cannot resolve {}", host_);
+            return;
+        }
+        sock_ = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int rc = sock_ < 0 ? -1 : ::connect(sock_, res->ai_addr, res->ai_addrlen);
+        freeaddrinfo(res);
+        if (rc < 0 && errno != EINPROGRESS)
+        {
+            LOG_WARN("Modbus TCP: connect {}:{} failed: {}", host_, port_, strerror(errno));
+            if (sock_ >= 0)
+                close(sock_);
+            sock_ = -1;
+            return;
+        }
+        int one = 1;
+        setsockopt(sock_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.fd = sock_;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, sock_, &ev);
+        interest_ = ev.events;
+        connecting_ = true;
+        if (rc == 0)
+            finishConnect();
+    }
+
+    void finishConnect()
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(sock_, SOL_SOCKET, SO_ERROR, &err, &len);
+        connecting_ = false;
+        if (err != 0)
+        {
+            LOG_WARN("Modbus TCP: connect {}:{} failed: {}", host_, port_, strerror(err));
+            closeSocket("connect failed");
+            return;
+        }
+        connected_ = true;
+        LOG_INFO("Modbus TCP: connected to {}:{}", host_, port_);
+    }
+
+    // 断线：在途请求全部以超时结束，1s 后重连
+    void closeSocket(const char *reason)
+    {
+        if (sock_ < 0)
+            return;
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, sock_, nullptr);
+        close(sock_);
+        sock_ = -1;
+        if (connected_)
+            LOG_WARN("Modbus TCP: {}:{} closed ({}), {} requests failed", host_, port_, reason, inflight_.size());
+        connected_ = false;
+        connecting_ = false;
+        retry_at_ = clock::now() + std::chrono::seconds(1);
+        outbuf_.clear();
+        inbuf_.clear();
+        auto failed = std::move(inflight_);
+        inflight_.clear();
+        for (auto &f : failed)
+            complete(f.second.t, modbus::Response());
+    }
+
+    // 连不上时不让请求一直挂着
+    void failQueued()
+    {
+        modbus::Transaction t;
+        while (sched_.tryNext(t))
+            complete(t, modbus::Response());
+    }
+
+    // 在途没满就继续从调度器取
+    void fill(clock::time_point now)
+    {
+        modbus::Transaction t;
+        while (inflight_.size() < max_outstanding_ && sched_.tryNext(t))
+        {
+            uint16_t tid = next_tid_++;
+            while (inflight_.count(tid))
+                tid = next_tid_++;
+            auto frame = modbus::tcpFrame(tid, t.request);
+            outbuf_.insert(outbuf_.end(), frame.begin(), frame.end());
+            inflight_[tid] = Inflight{std::move(t), now + timeout_};
+        }
+    }
+
+    void flush()
+    {
+        while (sock_ >= 0 && connected_ && !outbuf_.empty())
+        {
+            ssize_t n = send(sock_, outbuf_.data(), outbuf_.size(), MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    closeSocket(strerror(errno));
+                return;
+            }
+            outbuf_.erase(outbuf_.begin(), outbuf_.begin() + n);
+        }
+    }
+
+    void readable()
+    {
+        uint8_t buf[1024];
+        while (sock_ >= 0)
+        {
+            ssize_t n = recv(sock_, buf, sizeof(buf), 0);
+            if (n == 0)
+            {
+                closeSocket("closed by peer");
+                return;
+            }
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    closeSocket(strerror(errno));
+                break;
+            }
+            inbuf_.insert(inbuf_.end(), buf, buf + n);
+        }
+
+        size_t off = 0;
+        while (sock_ >= 0)
+        {
+            size_t len = modbus::tcpFrameLength(inbuf_.data() + off, inbuf_.size() - off);
+            if (len == 0)
+                break;
+            const uint8_t *f = inbuf_.data() + off;
+            if (len < modbus::MBAP_HEADER_SIZE + 1 || modbus::getU16(f + 2) != 0)
+            {
+                closeSocket("bad MBAP header");
+                return;
+            }
+            auto it = inflight_.find(modbus::getU16(f));
+            if (it != inflight_.end())
+            {
+                // 超时后才到的应答找不到事务号，直接丢弃
+                modbus::Transaction t = std::move(it->second.t);
+                inflight_.erase(it);
+                modbus::Response rsp;
+                if (f[6] != t.request.slave)
+                    rsp.status = modbus::Status::BAD_FRAME;
+                else
+                    modbus::decodePdu(t.request, f + modbus::MBAP_HEADER_SIZE, len - modbus::MBAP_HEADER_SIZE, rsp);
+                complete(t, rsp);
+            }
+            off += len;
+        }
+        if (sock_ >= 0)
+            inbuf_.erase(inbuf_.begin(), inbuf_.begin() + off);
+    }
+
+    void expire(clock::time_point now)
+    {
+        for (auto it = inflight_.begin(); it != inflight_.end();)
+        {
+            if (it->second.deadline > now)
+            {
+                ++it;
+                continue;
+            }
+            modbus::Transaction t = std::move(it->second.t);
+            it = inflight_.erase(it);
+            LOG_WARN("Modbus TCP: slave {} fc {} addr {} timed out", static_cast<int>(t.request.slave),
+                     static_cast<int>(t.request.function), t.request.address);
+            complete(t, modbus::Response());
+        }
+    }
+
+    void complete(modbus::Transaction &t, const modbus::Response &rsp)
+    {
+        if (t.done)
+            t.done(rsp);
+    }
+
+    void updateInterest()
+    {
+        if (sock_ < 0)
+            return;
+        uint32_t want = EPOLLIN;
+        if (connecting_ || !outbuf_.empty())
+            want |= EPOLLOUT;
+        if (want == interest_)
+            return;
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = want;
+        ev.data.fd = sock_;
+        epoll_ctl(epfd_, EPOLL_CTL_MOD, sock_, &ev);
+        interest_ = want;
+    }
+
+    std::string host_;
+    uint16_t port_;
+    size_t max_outstanding_;
+    std::chrono::milliseconds timeout_;
+
+    int epfd_ = -1;
+    int evfd_ = -1;
+    int sock_ = -1;
+    uint32_t interest_ = 0;
+    bool connecting_ = false;
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> running_{false};
+    clock::time_point retry_at_;
+    uint16_t next_tid_ = 1;
+    std::vector<uint8_t> outbuf_;
+    std::vector<uint8_t> inbuf_;
+    std::map<uint16_t, Inflight> inflight_;
+    std::thread worker_;
+};
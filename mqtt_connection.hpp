@@ -0,0 +1,753 @@
+#pragma once
+// mqtt_connection.hpp
+// 发布和订阅共用的一条 MQTT 连接：一个 async_client、一套重连策略
+#include <mqtt/async_client.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ElegantLog.hpp"
+#include "mqtt_v5.hpp"
+#include "publish_scheduler.hpp"
+#include "topic_router.hpp"
+
+// 指数退避 + 抖动：第 n 次重试等待 [d/2, d]，d = min(base * 2^n, max)
+class Backoff
+{
+public:
+    Backoff(std::chrono::milliseconds base = std::chrono::milliseconds(500),
+            std::chrono::milliseconds max = std::chrono::seconds(60))
+        : base_(base), max_(max), rng_(std::random_device{}()) {}
+
+    std::chrono::milliseconds next()
+    {
+        long long d = static_cast<long long>(base_.count()) << std::min(attempt_, 16u);
+        if (d > max_.count())
+            d = max_.count();
+        ++attempt_;
+        std::uniform_int_distribution<long long> dist(d / 2, d);
+        return std::chrono::milliseconds(dist(rng_));
+    }
+    void reset() { attempt_ = 0; }
+    unsigned attempts() const { return attempt_; }
+
+private:
+    std::chrono::milliseconds base_;
+    std::chrono::milliseconds max_;
+    unsigned attempt_ = 0;
+    std::mt19937 rng_;
+};
+
+// 断线到重新连上的耗时统计
+struct ReconnectStats
+{
+    unsigned reconnects = 0;
+    std::chrono::milliseconds last{0};
+    std::chrono::milliseconds max{0};
+    std::chrono::milliseconds total{0};
+};
+
+class MqttConnection : public virtual mqtt::callback
+{
+public:
+    using message_handler = std::function<void(mqtt::const_message_ptr)>;
+    using subscribe_callback = std::function<void(bool)>;
+
+    /**
+     * @param hold_limit   每个优先级通道最多排队的消息数，超出丢最旧的
+     * @param max_inflight 交给 paho 还没确认的消息最多几条，其余留在通道里，
+     *                     积压补发时新来的告警只排在这几条后面
+     */
+    MqttConnection(std::string server = "broker.emqx.io:1883", std::string client_id = "cpp_sen_mqtt", bool v5 = false,
+                   size_t hold_limit = 1000, size_t max_inflight = 8)
+        : SERVER_ADDRESS(server), CLIENT_ID(client_id), USE_V5(v5),
+          m_max_inflight(std::max<size_t>(max_inflight, 1)), m_queue(hold_limit), client(SERVER_ADDRESS, CLIENT_ID, makeCreateOptions(v5))
+    {
+        client.set_callback(*this);
+        m_supervisor = std::thread(&MqttConnection::supervise, this);
+    }
+    ~MqttConnection()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cv.notify_all();
+        if (m_supervisor.joinable())
+            m_supervisor.join();
+        // 连接过程中或退避期间 disconnect() 直接返回，先停掉回调、等正在进行的 connect 结束，
+        // 免得 paho 线程在成员析构后还回调进来
+        client.disable_callbacks();
+        mqtt::token_ptr connecting;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            connecting = m_connect_token;
+        }
+        if (connecting)
+        {
+            try
+            {
+                connecting->wait_for(std::chrono::seconds(30));
+            }
+            catch (const mqtt::exception &)
+            {
+            }
+        }
+        disconnect();
+    }
+
+    // 异步发起连接，不阻塞调用线程；失败和断线由监护线程按退避策略重连
+    void connectAsync()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_want_connect = true;
+        }
+        m_cv.notify_all();
+    }
+
+    // 同步连接，超时抛 mqtt::exception
+    void connect(std::chrono::seconds timeout = std::chrono::seconds(30))
+    {
+        connectAsync();
+        if (!waitConnected(timeout))
+            throw mqtt::exception(MQTTASYNC_FAILURE, "connect timeout");
+    }
+
+    // 等待连接成功，超时返回 false
+    template <typename Rep, typename Period>
+    bool waitConnected(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait_for(lock, timeout, [this]
+                      { return m_connected || !m_running; });
+        return m_connected;
+    }
+
+    void disconnect()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_want_connect = false;
+            m_connected = false;
+        }
+        if (!client.is_connected())
+            return;
+        try
+        {
+            client.disconnect()->wait();
+            LOG_INFO("Disconnected from EMQX broker");
+        }
+        catch (const mqtt::exception &exc)
+        {
+            LOG_ERROR("Error: {}", exc.what());
+        }
+    }
+
+    bool isConnected()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_connected;
+    }
+    bool isV5() const { return USE_V5; }
+
+    /**
+     * @brief 发布消息，不阻塞也不抛异常
+     * 消息按通道优先级和限速由监护线程发出；断线时留在队列里，重连后按顺序补发；
+     * 已发出但未确认的消息在断线时放回原通道最前面（至少一次）
+     * @param props v5 属性（响应主题、关联数据等），v3 连接下忽略
+     * @return true 当前在线，false 断线暂存等待重连
+     */
+    bool publish(const std::string &topic, const std::string &payload, int qos = 1, bool retained = false,
+                 Lane lane = Lane::LIVE, const mqtt::properties &props = mqtt::properties())
+    {
+        bool online;
+        bool full;
+        size_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Pending msg{++m_seq, lane, topic, payload, qos, retained, props, 0, 0};
+            full = !m_queue.push(lane, std::move(msg), topic.size() + payload.size());
+            if (full)
+                dropped = m_queue.dropped(lane);
+            online = m_connected;
+        }
+        m_cv.notify_all();
+        if (full)
+            LOG_WARN("{} lane full, dropped oldest message ({} total)", laneToString(lane), dropped);
+        return online;
+    }
+
+    // 通道限速，bytes_per_sec 为 0 不限速
+    void setLaneRate(Lane lane, double bytes_per_sec, double burst = 0)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.setRate(lane, bytes_per_sec, burst);
+    }
+
+    /**
+     * @brief 批量订阅，所有过滤器放在一个 SUBSCRIBE 包里，不阻塞调用线程
+     * 订阅会被记录下来，重连后合并成一个包重新发出；未连接时等连上再发。
+     * SUBACK 里被拒绝的过滤器从记录里去掉
+     * @param done 完成回调（在 paho 线程里调用），全部被服务端接受为 true
+     * @return 同样的结果
+     */
+    std::future<bool> subscribeMany(const std::vector<std::pair<std::string, int>> &filters,
+                                    subscribe_callback done = nullptr)
+    {
+        auto req = std::make_shared<SubscribeRequest>();
+        req->done = std::move(done);
+        std::future<bool> result = req->promise.get_future();
+        bool online;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto &f : filters)
+            {
+                auto it = std::find_if(m_subscriptions.begin(), m_subscriptions.end(),
+                                       [&f](const std::pair<std::string, int> &s)
+                                       { return s.first == f.first; });
+                if (it != m_subscriptions.end())
+                    it->second = f.second;
+                else
+                    m_subscriptions.push_back(f);
+            }
+            online = m_connected;
+            if (!online)
+                m_pending_subs.push_back(req);
+        }
+        if (filters.empty())
+            req->complete(true);
+        else if (online)
+            sendSubscribe(filters, {req});
+        return result;
+    }
+
+    std::future<bool> subscribe(const std::string &topic, int qos = 1, subscribe_callback done = nullptr)
+    {
+        return subscribeMany({{topic, qos}}, std::move(done));
+    }
+
+    /**
+     * @brief 按主题过滤器注册处理函数，在 paho 回调线程里调用
+     * @return 句柄，用于 removeMessageHandler；过滤器不合法时返回 0
+     */
+    int addMessageHandler(const std::string &filter, message_handler handler)
+    {
+        return m_router.add(filter, std::move(handler));
+    }
+
+    /**
+     * @brief 注销处理函数，返回时它已经不在运行，捕获的对象可以析构
+     * 在处理函数里调用时不等（等不到自己），这条消息匹配到的其他处理函数仍会被调用
+     */
+    void removeMessageHandler(int id)
+    {
+        m_router.remove(id);
+        std::unique_lock<std::mutex> lock(m_dispatch_mutex);
+        if (m_dispatching && m_dispatch_thread == std::this_thread::get_id())
+            return;
+        // 只等注销之前已经开始的分发，消息不断时也不会一直等下去
+        uint64_t started = m_dispatch_started;
+        m_dispatch_cv.wait(lock, [this, started]
+                           { return m_dispatch_finished >= started; });
+    }
+
+    ReconnectStats reconnectStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+    size_t heldMessages()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size();
+    }
+    size_t heldMessages(Lane lane)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size(lane);
+    }
+    size_t droppedMessages(Lane lane)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.dropped(lane);
+    }
+
+private:
+    struct Pending
+    {
+        uint64_t seq;
+        Lane lane;
+        std::string topic;
+        std::string payload;
+        int qos;
+        bool retained;
+        mqtt::properties props;
+        uint16_t alias;      ///< 这次发送带的主题别名，0 表示没带
+        unsigned generation; ///< 发送时的连接代数
+    };
+
+    // 一次发布，作为 user context 带到 PublishListener
+    struct PublishTag
+    {
+        uint64_t seq;
+        unsigned generation;
+    };
+
+    // 首次连接和每次重连的结果
+    class ConnectListener : public virtual mqtt::iaction_listener
+    {
+    public:
+        explicit ConnectListener(MqttConnection &conn) : conn_(conn) {}
+
+    private:
+        void on_success(const mqtt::token &tok) override
+        {
+            if (conn_.USE_V5)
+            {
+                conn_.aliases.reset(topicAliasMaximum(tok));
+                LOG_INFO("Connected to EMQX broker (v5, topic alias max {})", conn_.aliases.maximum());
+            }
+            else
+            {
+                LOG_INFO("Connected to EMQX broker");
+            }
+        }
+
+        void on_failure(const mqtt::token &tok) override
+        {
+            LOG_ERROR("Failed to connect to EMQX broker: rc {}", tok.get_return_code());
+            {
+                std::lock_guard<std::mutex> lock(conn_.m_mutex);
+                conn_.m_connecting = false;
+            }
+            conn_.m_cv.notify_all();
+        }
+
+        MqttConnection &conn_;
+    };
+
+    // 发布结果，user context 带回序号和连接代数；
+    // 重连前那次发送迟到的回调代数对不上，不能动已经重新入队/重发的同序号消息
+    class PublishListener : public virtual mqtt::iaction_listener
+    {
+    public:
+        explicit PublishListener(MqttConnection &conn) : conn_(conn) {}
+
+    private:
+        // 确认一条就让监护线程从通道里补一条，窗口里始终是当前优先级最高的消息
+        void on_success(const mqtt::token &tok) override
+        {
+            std::unique_ptr<PublishTag> tag(static_cast<PublishTag *>(tok.get_user_context()));
+            {
+                std::lock_guard<std::mutex> lock(conn_.m_mutex);
+                auto it = conn_.m_inflight.find(tag->seq);
+                if (it == conn_.m_inflight.end() || it->second.generation != tag->generation)
+                    return;
+                // 服务端收到了完整主题+别名，之后才能只发别名
+                if (it->second.alias != 0)
+                    conn_.aliases.confirm(it->second.topic, it->second.alias);
+                conn_.m_inflight.erase(it);
+            }
+            conn_.m_cv.notify_all();
+        }
+
+        void on_failure(const mqtt::token &tok) override
+        {
+            std::unique_ptr<PublishTag> tag(static_cast<PublishTag *>(tok.get_user_context()));
+            LOG_WARN("Publish failed: rc {}", tok.get_return_code());
+            // 断线导致的失败留给 connection_lost 重新入队，连接正常时说明消息本身有问题
+            {
+                std::lock_guard<std::mutex> lock(conn_.m_mutex);
+                if (!conn_.m_connected)
+                    return;
+                auto it = conn_.m_inflight.find(tag->seq);
+                if (it == conn_.m_inflight.end() || it->second.generation != tag->generation)
+                    return;
+                conn_.m_inflight.erase(it);
+            }
+            conn_.m_cv.notify_all();
+        }
+
+        MqttConnection &conn_;
+    };
+
+    // 一次 subscribeMany 调用的结果
+    struct SubscribeRequest
+    {
+        std::promise<bool> promise;
+        subscribe_callback done;
+
+        void complete(bool ok)
+        {
+            promise.set_value(ok);
+            if (done)
+                done(ok);
+        }
+    };
+
+    // 一个 SUBSCRIBE 包，作为 user context 带到 SubscribeListener
+    struct SubscribeBatch
+    {
+        std::vector<std::pair<std::string, int>> filters;
+        std::vector<std::shared_ptr<SubscribeRequest>> requests;
+    };
+
+    class SubscribeListener : public virtual mqtt::iaction_listener
+    {
+    public:
+        explicit SubscribeListener(MqttConnection &conn) : conn_(conn) {}
+
+    private:
+        void on_success(const mqtt::token &tok) override
+        {
+            std::unique_ptr<SubscribeBatch> batch(static_cast<SubscribeBatch *>(tok.get_user_context()));
+            // SUBACK 里每个过滤器一个结果码，>= 0x80 表示被拒绝
+            bool ok = true;
+            auto codes = tok.get_subscribe_response().get_reason_codes();
+            for (size_t i = 0; i < codes.size() && i < batch->filters.size(); ++i)
+            {
+                if (codes[i] >= 0x80)
+                {
+                    LOG_ERROR("Subscribe rejected: {} (rc {})", batch->filters[i].first, static_cast<int>(codes[i]));
+                    conn_.forgetSubscription(batch->filters[i].first);
+                    ok = false;
+                }
+            }
+            if (ok)
+                LOG_INFO("Subscribed to {} topics", batch->filters.size());
+            for (auto &r : batch->requests)
+                r->complete(ok);
+        }
+
+        void on_failure(const mqtt::token &tok) override
+        {
+            std::unique_ptr<SubscribeBatch> batch(static_cast<SubscribeBatch *>(tok.get_user_context()));
+            LOG_WARN("Subscribe failed: rc {}", tok.get_return_code());
+            conn_.retryOrFail(batch->requests);
+        }
+
+        MqttConnection &conn_;
+    };
+
+    void sendSubscribe(const std::vector<std::pair<std::string, int>> &filters,
+                       std::vector<std::shared_ptr<SubscribeRequest>> requests)
+    {
+        auto topics = std::make_shared<mqtt::string_collection>();
+        mqtt::iasync_client::qos_collection qos;
+        for (const auto &f : filters)
+        {
+            topics->push_back(f.first);
+            qos.push_back(f.second);
+        }
+        std::unique_ptr<SubscribeBatch> batch(new SubscribeBatch{filters, std::move(requests)});
+        try
+        {
+            client.subscribe(topics, qos, batch.get(), m_subscribe_listener);
+            batch.release();
+        }
+        catch (const mqtt::exception &exc)
+        {
+            LOG_WARN("Subscribe deferred: {}", exc.what());
+            retryOrFail(batch->requests);
+        }
+    }
+
+    // 被服务端拒绝的过滤器不再记着，否则每次重连都会再发一遍
+    void forgetSubscription(const std::string &filter)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_subscriptions.erase(std::remove_if(m_subscriptions.begin(), m_subscriptions.end(),
+                                             [&filter](const std::pair<std::string, int> &s)
+                                             { return s.first == filter; }),
+                              m_subscriptions.end());
+    }
+
+    // 断线导致的失败等重连后随整体订阅一起完成，连接正常时就是真的失败
+    void retryOrFail(std::vector<std::shared_ptr<SubscribeRequest>> &requests)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_connected)
+            {
+                m_pending_subs.insert(m_pending_subs.end(), requests.begin(), requests.end());
+                return;
+            }
+        }
+        for (auto &r : requests)
+            r->complete(false);
+    }
+
+    bool send(mqtt::message_ptr msg, uint64_t seq, unsigned generation)
+    {
+        std::unique_ptr<PublishTag> tag(new PublishTag{seq, generation});
+        try
+        {
+            client.publish(msg, tag.get(), m_publish_listener);
+            tag.release();
+            return true;
+        }
+        catch (const mqtt::exception &exc)
+        {
+            // 多半是刚好断线，等 connection_lost 把它放回暂存队列
+            LOG_WARN("Publish deferred: {}", exc.what());
+            return false;
+        }
+    }
+
+    // 监护线程：按退避策略发起连接，连上后按通道优先级和限速发送
+    void supervise()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running)
+        {
+            m_cv.wait(lock, [this]
+                      { return !m_running || (m_want_connect && !m_connected && !m_connecting) ||
+                               (m_connected && !m_queue.empty() && m_inflight.size() < m_max_inflight); });
+            if (!m_running)
+                break;
+
+            if (m_connected)
+            {
+                auto wait = drainLocked(lock);
+                if (wait > std::chrono::steady_clock::duration::zero())
+                {
+                    // 限速或发送失败：等令牌或者新的更高优先级消息
+                    m_cv.wait_for(lock, std::min<std::chrono::steady_clock::duration>(wait, std::chrono::seconds(1)));
+                }
+                continue;
+            }
+
+            // 第一次立即连，之后按退避等待，期间可被停止打断
+            if (m_backoff.attempts() > 0 || m_ever_connected)
+            {
+                auto delay = m_backoff.next();
+                LOG_INFO("Reconnecting in {} ms (attempt {})", delay.count(), m_backoff.attempts());
+                if (m_cv.wait_for(lock, delay, [this]
+                                  { return !m_running || !m_want_connect; }))
+                    continue;
+            }
+            else
+            {
+                m_backoff.next();
+            }
+
+            m_connecting = true;
+            lock.unlock();
+            mqtt::token_ptr tok;
+            try
+            {
+                tok = client.connect(makeConnectOptions(USE_V5), nullptr, m_connect_listener);
+            }
+            catch (const mqtt::exception &exc)
+            {
+                LOG_ERROR("Error: {}", exc.what());
+            }
+            lock.lock();
+            m_connect_token = tok;
+            if (!tok)
+                m_connecting = false;
+        }
+    }
+
+    // 持锁进入；发到队列空、被限速或者在途窗口满为止，返回需要等待的时间。
+    // 窗口满时留在通道里，等 PublishListener 确认后再取，后来的高优先级消息不会排在整批积压后面
+    std::chrono::steady_clock::duration drainLocked(std::unique_lock<std::mutex> &lock)
+    {
+        std::chrono::steady_clock::duration wait = std::chrono::steady_clock::duration::zero();
+        Pending msg;
+        while (m_connected && m_inflight.size() < m_max_inflight && m_queue.pop(msg, wait))
+        {
+            mqtt::message_ptr wire = makeMessage(msg);
+            msg.generation = m_generation;
+            m_inflight[msg.seq] = msg;
+            lock.unlock();
+            bool ok = send(wire, msg.seq, msg.generation);
+            lock.lock();
+            if (!ok)
+            {
+                // 没交给 paho，不会有回调：放回通道最前面稍后重发，不占在途窗口。
+                // 期间断线的话 connection_lost 已经把它放回去了
+                auto it = m_inflight.find(msg.seq);
+                if (it != m_inflight.end())
+                {
+                    size_t bytes = it->second.topic.size() + it->second.payload.size();
+                    it->second.alias = 0;
+                    m_queue.pushFront(it->second.lane, std::move(it->second), bytes);
+                    m_inflight.erase(it);
+                }
+                return std::chrono::milliseconds(200);
+            }
+        }
+        return m_queue.empty() ? std::chrono::steady_clock::duration::zero() : wait;
+    }
+
+    void connected(const std::string &cause) override
+    {
+        std::vector<std::pair<std::string, int>> subs;
+        std::vector<std::shared_ptr<SubscribeRequest>> waiting;
+        bool reconnect;
+        std::chrono::milliseconds latency{0};
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            reconnect = m_ever_connected;
+            m_ever_connected = true;
+            m_connected = true;
+            m_connecting = false;
+            m_backoff.reset();
+            if (reconnect)
+            {
+                latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - m_lost_at);
+                ++m_stats.reconnects;
+                m_stats.last = latency;
+                m_stats.max = std::max(m_stats.max, latency);
+                m_stats.total += latency;
+            }
+            subs = m_subscriptions;
+            waiting.swap(m_pending_subs);
+        }
+        m_cv.notify_all();
+
+        if (reconnect)
+        {
+            LOG_INFO("Reconnected to EMQX broker after {} ms: {}", latency.count(), cause);
+            if (USE_V5)
+                aliases.reset(aliases.maximum());
+        }
+        // 所有订阅合并成一个包恢复，离线期间提交的订阅请求随它一起完成
+        if (!subs.empty())
+        {
+            sendSubscribe(subs, std::move(waiting));
+            return;
+        }
+        for (auto &r : waiting)
+            r->complete(true);
+    }
+
+    void connection_lost(const std::string &cause) override
+    {
+        size_t requeued;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_connected = false;
+            ++m_generation;
+            m_lost_at = std::chrono::steady_clock::now();
+            // 未确认的消息按原顺序放回各自通道最前面，重发时重新决定带不带别名
+            requeued = m_inflight.size();
+            for (auto it = m_inflight.rbegin(); it != m_inflight.rend(); ++it)
+            {
+                size_t bytes = it->second.topic.size() + it->second.payload.size();
+                it->second.alias = 0;
+                m_queue.pushFront(it->second.lane, std::move(it->second), bytes);
+            }
+            m_inflight.clear();
+        }
+        if (USE_V5)
+            aliases.invalidate();
+        m_cv.notify_all();
+        LOG_WARN("Connection lost: {} ({} unacked messages requeued)", cause, requeued);
+    }
+
+    // 分发期间计数，removeMessageHandler 据此等正在运行的处理函数返回
+    class DispatchScope
+    {
+    public:
+        explicit DispatchScope(MqttConnection &conn) : conn_(conn)
+        {
+            std::lock_guard<std::mutex> lock(conn_.m_dispatch_mutex);
+            ++conn_.m_dispatch_started;
+            conn_.m_dispatching = true;
+            conn_.m_dispatch_thread = std::this_thread::get_id();
+        }
+        ~DispatchScope()
+        {
+            {
+                std::lock_guard<std::mutex> lock(conn_.m_dispatch_mutex);
+                ++conn_.m_dispatch_finished;
+                conn_.m_dispatching = false;
+            }
+            conn_.m_dispatch_cv.notify_all();
+        }
+
+    private:
+        MqttConnection &conn_;
+    };
+
+    // paho 只有一个回调线程，分发是串行的
+    void message_arrived(mqtt::const_message_ptr msg) override
+    {
+        // 只在本线程用，避免每条消息分配
+        thread_local std::vector<message_handler> handlers;
+        DispatchScope scope(*this);
+        m_router.match(msg->get_topic(), handlers);
+        for (auto &h : handlers)
+        {
+            h(msg);
+        }
+        handlers.clear();
+    }
+
+    // 用到的别名记在 msg.alias 里，发布成功后确认
+    mqtt::message_ptr makeMessage(Pending &msg)
+    {
+        msg.alias = 0;
+        if (!USE_V5)
+            return mqtt::make_message(msg.topic, msg.payload, msg.qos, msg.retained);
+
+        std::string wireTopic;
+        aliases.resolve(msg.topic, wireTopic, msg.alias);
+        mqtt::properties props = msg.props;
+        if (msg.alias == 0)
+            return mqtt::message::create(msg.topic, msg.payload, msg.qos, msg.retained, props);
+        props.add(mqtt::property(mqtt::property::TOPIC_ALIAS, msg.alias));
+        return mqtt::message::create(wireTopic, msg.payload, msg.qos, msg.retained, props);
+    }
+
+    std::string SERVER_ADDRESS;
+    std::string CLIENT_ID;
+    bool USE_V5;
+
+    TopicAliasTable aliases;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_running = true;
+    bool m_want_connect = false;
+    bool m_connecting = false;
+    bool m_connected = false;
+    bool m_ever_connected = false;
+    Backoff m_backoff;
+    std::chrono::steady_clock::time_point m_lost_at;
+    ReconnectStats m_stats;
+    ConnectListener m_connect_listener{*this};
+    PublishListener m_publish_listener{*this};
+    SubscribeListener m_subscribe_listener{*this};
+    std::vector<std::pair<std::string, int>> m_subscriptions;
+    std::vector<std::shared_ptr<SubscribeRequest>> m_pending_subs; ///< 离线时提交，等连上后完成
+    TopicRouter<message_handler> m_router;
+    std::mutex m_dispatch_mutex;
+    std::condition_variable m_dispatch_cv;
+    uint64_t m_dispatch_started = 0;
+    uint64_t m_dispatch_finished = 0;
+    bool m_dispatching = false;
+    std::thread::id m_dispatch_thread;
+
+    uint64_t m_seq = 0;
+    unsigned m_generation = 0; ///< 每次断线加一
+    const size_t m_max_inflight;
+    LaneScheduler<Pending> m_queue;         ///< 待发送，按通道排队
+    std::map<uint64_t, Pending> m_inflight; ///< 已发出未确认
+    mqtt::token_ptr m_connect_token;        ///< 最近一次 connect，析构时等它结束
+    std::thread m_supervisor;
+    // 放在最后：最先析构，paho 的线程和回调停掉之后才释放上面的路由、监听器和队列
+    mqtt::async_client client;
+};
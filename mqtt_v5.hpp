@@ -0,0 +1,180 @@
+#pragma once
+// mqtt_v5.hpp
+// MQTT v5 相关：主题别名表、连接参数（会话过期代替 clean_session）
+#include <mqtt/async_client.h>
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 会话保留时间(秒)，断线重连后不用重新建会话和订阅
+const uint32_t MQTT_SESSION_EXPIRY = 3600;
+
+inline mqtt::create_options makeCreateOptions(bool v5)
+{
+    return mqtt::create_options(v5 ? MQTTVERSION_5 : MQTTVERSION_DEFAULT);
+}
+
+inline mqtt::connect_options makeConnectOptions(bool v5, uint32_t sessionExpiry = MQTT_SESSION_EXPIRY)
+{
+    if (!v5)
+    {
+        mqtt::connect_options connOpts;
+        connOpts.set_keep_alive_interval(20);
+        connOpts.set_clean_session(true);
+        return connOpts;
+    }
+    auto connOpts = mqtt::connect_options::v5();
+    connOpts.set_keep_alive_interval(20);
+    connOpts.set_clean_start(false);
+    connOpts.set_properties({mqtt::property(mqtt::property::SESSION_EXPIRY_INTERVAL,
+                                            static_cast<int32_t>(sessionExpiry))});
+    return connOpts;
+}
+
+// 从 CONNACK 里取服务端允许的主题别名数，没有则为 0（不能用别名）
+inline uint16_t topicAliasMaximum(const mqtt::token &tok)
+{
+    auto rsp = tok.get_connect_response();
+    if (rsp.get_mqtt_version() < MQTTVERSION_5)
+        return 0;
+    const auto &props = rsp.get_properties();
+    if (!props.contains(mqtt::property::TOPIC_ALIAS_MAXIMUM))
+        return 0;
+    return mqtt::get<uint16_t>(props, mqtt::property::TOPIC_ALIAS_MAXIMUM);
+}
+
+/**
+ * @brief 主题别名表
+ * 同一主题发布次数达到阈值后分配一个别名；带完整主题+别名的发布被确认（confirm）后才算建立映射，
+ * 之后只发空主题+别名。别名映射只在一条网络连接内有效，重连后编号保留，
+ * 但要重新带一次完整主题。
+ * 只记有别名的主题（最多 maximum 个），别名用完时回收最久没发过的那个；
+ * 还没到阈值的主题只在一个小表里计数，满了清空重来，请求/应答这种一次性主题不会让表一直长
+ */
+class TopicAliasTable
+{
+public:
+    explicit TopicAliasTable(unsigned hotThreshold = 2) : hot_threshold_(hotThreshold) {}
+
+    // 每次连接成功后调用，maximum 为服务端给的 Topic Alias Maximum
+    void reset(uint16_t maximum)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maximum_ = maximum;
+        next_alias_ = 1;
+        for (auto it = entries_.begin(); it != entries_.end();)
+        {
+            if (it->second.alias > maximum_)
+            {
+                lru_.erase(it->second.lru);
+                it = entries_.erase(it);
+                continue;
+            }
+            it->second.established = false;
+            if (it->second.alias >= next_alias_)
+                next_alias_ = it->second.alias + 1;
+            ++it;
+        }
+    }
+
+    // 连接断开：已发出去的映射作废，重发的消息重新带完整主题
+    void invalidate()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &e : entries_)
+            e.second.established = false;
+    }
+
+    /**
+     * @brief 决定这次发布怎么带主题
+     * @param topic     完整主题
+     * @param wireTopic 实际要发送的主题（可能为空串）
+     * @param alias     要带的别名，0 表示不带
+     */
+    void resolve(const std::string &topic, std::string &wireTopic, uint16_t &alias)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wireTopic = topic;
+        alias = 0;
+        if (maximum_ == 0)
+            return;
+        auto it = entries_.find(topic);
+        if (it == entries_.end())
+        {
+            if (!hot(topic))
+                return;
+            uint16_t a;
+            if (next_alias_ <= maximum_)
+            {
+                a = next_alias_++;
+            }
+            else
+            {
+                // 别名用完，回收最久没用的；之前带这个别名的消息已经按顺序发在前面
+                auto victim = entries_.find(lru_.back());
+                a = victim->second.alias;
+                entries_.erase(victim);
+                lru_.pop_back();
+            }
+            lru_.push_front(topic);
+            it = entries_.emplace(topic, Entry{a, false, lru_.begin()}).first;
+        }
+        else
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+        }
+        alias = it->second.alias;
+        if (it->second.established)
+            wireTopic.clear();
+    }
+
+    // 带完整主题+alias 的发布成功后调用，之后这个主题只发别名
+    void confirm(const std::string &topic, uint16_t alias)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(topic);
+        if (it != entries_.end() && it->second.alias == alias)
+            it->second.established = true;
+    }
+
+    uint16_t maximum() const { return maximum_.load(); }
+
+private:
+    static const size_t CANDIDATE_LIMIT = 64;
+
+    struct Entry
+    {
+        uint16_t alias;
+        bool established;
+        std::list<std::string>::iterator lru;
+    };
+
+    // 计一次发布，到阈值返回 true
+    bool hot(const std::string &topic)
+    {
+        if (hot_threshold_ <= 1)
+            return true;
+        auto c = candidates_.find(topic);
+        if (c == candidates_.end())
+        {
+            if (candidates_.size() >= CANDIDATE_LIMIT)
+                candidates_.clear();
+            c = candidates_.emplace(topic, 0u).first;
+        }
+        if (++c->second < hot_threshold_)
+            return false;
+        candidates_.erase(c);
+        return true;
+    }
+
+    unsigned hot_threshold_;
+    std::atomic<uint16_t> maximum_{0}; // reset 在锁里写，maximum() 不加锁读
+    uint16_t next_alias_ = 1;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; ///< 有别名的主题，最近用过的在前
+    std::unordered_map<std::string, unsigned> candidates_;
+    std::mutex mutex_;
+};
@@ -0,0 +1,482 @@
+#pragma once
+// payload_codec.hpp
+// 上报数据的编码/解码：文本、CBOR(RFC 8949 子集)、按寄存器表打包的定长二进制
+#include <stdint.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "frame_comm.hpp"
+
+enum class PayloadFormat
+{
+    TEXT,   // "x: 1.234567,y: ..., z: ..., t: ..." 和旧版逐字节一致
+    CBOR,   // {"x": f32, "y": f32, ...}
+    PACKED  // 0xFF + 表ID + 寄存器镜像
+};
+
+inline bool parsePayloadFormat(const std::string &name, PayloadFormat &fmt)
+{
+    if (name == "text")
+        fmt = PayloadFormat::TEXT;
+    else if (name == "cbor")
+        fmt = PayloadFormat::CBOR;
+    else if (name == "packed")
+        fmt = PayloadFormat::PACKED;
+    else
+        return false;
+    return true;
+}
+
+// ==================== 寄存器表 ====================
+enum class RegType : uint8_t
+{
+    U16, // 1个寄存器
+    F32  // 2个寄存器，字节序与设备上送一致（小端）
+};
+
+struct RegField
+{
+    const char *name;
+    uint16_t reg; // 相对起始寄存器的偏移
+    RegType type;
+};
+
+struct RegisterMap
+{
+    uint8_t id; // 打包格式中用来找回寄存器表
+    std::vector<RegField> fields;
+
+    uint16_t regCount() const
+    {
+        uint16_t cnt = 0;
+        for (const auto &f : fields)
+        {
+            uint16_t end = f.reg + (f.type == RegType::F32 ? 2 : 1);
+            if (end > cnt)
+                cnt = end;
+        }
+        return cnt;
+    }
+};
+
+// 传感器：从 0 号寄存器开始 8 个寄存器，4 个 float
+inline const RegisterMap &sensorRegisterMap()
+{
+    static const RegisterMap map{1, {{"x", 0, RegType::F32},
+                                     {"y", 2, RegType::F32},
+                                     {"z", 4, RegType::F32},
+                                     {"t", 6, RegType::F32}}};
+    return map;
+}
+
+// WeatherData 是 1 字节对齐的结构体，按 16 位寄存器排布正好对得上
+inline const RegisterMap &weatherRegisterMap()
+{
+    static const RegisterMap map{2, {{"avgWindSpeed10min", 0, RegType::F32},
+                                     {"avgWindDir10min", 2, RegType::U16},
+                                     {"maxWindSpeed", 3, RegType::F32},
+                                     {"extremeWindSpeed", 5, RegType::F32},
+                                     {"stdWindSpeed", 7, RegType::F32},
+                                     {"airTemperature", 9, RegType::F32},
+                                     {"humidity", 11, RegType::U16},
+                                     {"airPressure", 12, RegType::F32},
+                                     {"precipitation", 14, RegType::F32},
+                                     {"precipIntensity", 16, RegType::F32},
+                                     {"radiationIntensity", 18, RegType::U16}}};
+    return map;
+}
+
+inline const RegisterMap *findRegisterMap(uint8_t id)
+{
+    if (id == sensorRegisterMap().id)
+        return &sensorRegisterMap();
+    if (id == weatherRegisterMap().id)
+        return &weatherRegisterMap();
+    return nullptr;
+}
+
+// ==================== CBOR ====================
+class CborWriter
+{
+public:
+    explicit CborWriter(std::string &out) : out_(out) {}
+
+    void map(size_t n) { head(5, n); }
+    void array(size_t n) { head(4, n); }
+    void uint(uint64_t v) { head(0, v); }
+    void sint(int64_t v)
+    {
+        if (v < 0)
+            head(1, static_cast<uint64_t>(-1 - v));
+        else
+            head(0, static_cast<uint64_t>(v));
+    }
+    void text(const char *s, size_t len)
+    {
+        head(3, len);
+        out_.append(s, len);
+    }
+    void text(const char *s) { text(s, strlen(s)); }
+    void bytes(const uint8_t *data, size_t len)
+    {
+        head(2, len);
+        out_.append(reinterpret_cast<const char *>(data), len);
+    }
+    void f32(float v)
+    {
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        out_.push_back(static_cast<char>(0xFA));
+        be(bits, 4);
+    }
+
+private:
+    void head(uint8_t major, uint64_t v)
+    {
+        uint8_t m = static_cast<uint8_t>(major << 5);
+        if (v < 24)
+        {
+            out_.push_back(static_cast<char>(m | v));
+        }
+        else if (v <= 0xFF)
+        {
+            out_.push_back(static_cast<char>(m | 24));
+            be(v, 1);
+        }
+        else if (v <= 0xFFFF)
+        {
+            out_.push_back(static_cast<char>(m | 25));
+            be(v, 2);
+        }
+        else if (v <= 0xFFFFFFFFull)
+        {
+            out_.push_back(static_cast<char>(m | 26));
+            be(v, 4);
+        }
+        else
+        {
+            out_.push_back(static_cast<char>(m | 27));
+            be(v, 8);
+        }
+    }
+    void be(uint64_t v, int n)
+    {
+        for (int i = n - 1; i >= 0; --i)
+            out_.push_back(static_cast<char>((v >> (i * 8)) & 0xFF));
+    }
+
+    std::string &out_;
+};
+
+class CborReader
+{
+public:
+    CborReader(const uint8_t *data, size_t len) : p_(data), end_(data + len) {}
+
+    bool atEnd() const { return p_ == end_; }
+
+    // 读取 map/array 的元素个数
+    bool container(uint8_t major, uint64_t &n)
+    {
+        uint8_t m;
+        return head(m, n) && m == major;
+    }
+    bool text(std::string &s)
+    {
+        uint8_t m;
+        uint64_t len;
+        if (!head(m, len) || m != 3 || static_cast<uint64_t>(end_ - p_) < len)
+            return false;
+        s.assign(reinterpret_cast<const char *>(p_), len);
+        p_ += len;
+        return true;
+    }
+    bool bytes(std::string &s)
+    {
+        uint8_t m;
+        uint64_t len;
+        if (!head(m, len) || m != 2 || static_cast<uint64_t>(end_ - p_) < len)
+            return false;
+        s.assign(reinterpret_cast<const char *>(p_), len);
+        p_ += len;
+        return true;
+    }
+    // 整数和浮点统一读成 double
+    bool number(double &v)
+    {
+        if (p_ == end_)
+            return false;
+        uint8_t ib = *p_;
+        if (ib == 0xFA || ib == 0xFB)
+        {
+            int n = ib == 0xFA ? 4 : 8;
+            ++p_;
+            uint64_t bits;
+            if (!be(bits, n))
+                return false;
+            if (n == 4)
+            {
+                uint32_t b32 = static_cast<uint32_t>(bits);
+                float f;
+                memcpy(&f, &b32, sizeof(f));
+                v = f;
+            }
+            else
+            {
+                memcpy(&v, &bits, sizeof(v));
+            }
+            return true;
+        }
+        uint8_t m;
+        uint64_t u;
+        if (!head(m, u))
+            return false;
+        if (m == 0)
+            v = static_cast<double>(u);
+        else if (m == 1)
+            v = -1.0 - static_cast<double>(u);
+        else
+            return false;
+        return true;
+    }
+
+private:
+    bool head(uint8_t &major, uint64_t &v)
+    {
+        if (p_ == end_)
+            return false;
+        uint8_t ib = *p_++;
+        major = ib >> 5;
+        uint8_t info = ib & 0x1F;
+        if (info < 24)
+        {
+            v = info;
+            return true;
+        }
+        if (info > 27)
+            return false; // 不定长编码不支持
+        return be(v, 1 << (info - 24));
+    }
+    bool be(uint64_t &v, int n)
+    {
+        if (end_ - p_ < n)
+            return false;
+        v = 0;
+        for (int i = 0; i < n; ++i)
+            v = (v << 8) | *p_++;
+        return true;
+    }
+
+    const uint8_t *p_;
+    const uint8_t *end_;
+};
+
+// ==================== 编解码 ====================
+struct FieldValue
+{
+    std::string name;
+    double value;
+};
+
+class PayloadCodec
+{
+public:
+    static const uint8_t PACKED_MAGIC = 0xFF; // CBOR 中 0xFF 不可能出现在首字节
+
+    // image 为寄存器镜像，长度至少 map.regCount() * 2
+    static std::string encode(const RegisterMap &map, const uint8_t *image, PayloadFormat fmt)
+    {
+        std::string out;
+        switch (fmt)
+        {
+        case PayloadFormat::PACKED:
+        {
+            size_t len = map.regCount() * 2;
+            out.reserve(2 + len);
+            out.push_back(static_cast<char>(PACKED_MAGIC));
+            out.push_back(static_cast<char>(map.id));
+            out.append(reinterpret_cast<const char *>(image), len);
+        }
+        break;
+        case PayloadFormat::CBOR:
+        {
+            CborWriter w(out);
+            w.map(map.fields.size());
+            for (const auto &f : map.fields)
+            {
+                w.text(f.name);
+                if (f.type == RegType::F32)
+                    w.f32(readF32(image, f.reg));
+                else
+                    w.uint(readU16(image, f.reg));
+            }
+        }
+        break;
+        case PayloadFormat::TEXT:
+        default:
+        {
+            for (size_t i = 0; i < map.fields.size(); ++i)
+            {
+                const auto &f = map.fields[i];
+                // 旧版传感器文本 x 和 y 之间只有逗号没有空格，订阅端可能按这个解析，保持原样
+                if (i)
+                    out += (i == 1 && map.id == sensorRegisterMap().id) ? "," : ", ";
+                out += f.name;
+                out += ": ";
+                if (f.type == RegType::F32)
+                    out += std::to_string(readF32(image, f.reg));
+                else
+                    out += std::to_string(readU16(image, f.reg));
+            }
+        }
+        break;
+        }
+        return out;
+    }
+
+    static std::string encodeSample(const std::vector<float> &values, PayloadFormat fmt)
+    {
+        const auto &map = sensorRegisterMap();
+        std::vector<uint8_t> image(map.regCount() * 2, 0);
+        memcpy(image.data(), values.data(), std::min(image.size(), values.size() * sizeof(float)));
+        return encode(map, image.data(), fmt);
+    }
+
+    static std::string encodeWeather(const WeatherData &wd, PayloadFormat fmt)
+    {
+        return encode(weatherRegisterMap(), reinterpret_cast<const uint8_t *>(&wd), fmt);
+    }
+
+    // 自动识别三种格式
+    static bool decode(const std::string &payload, std::vector<FieldValue> &fields)
+    {
+        fields.clear();
+        if (payload.empty())
+            return false;
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(payload.data());
+        uint8_t major = p[0] >> 5;
+        if (p[0] == PACKED_MAGIC)
+            return decodePacked(p, payload.size(), fields);
+        if (major == 5)
+            return decodeCbor(p, payload.size(), fields);
+        return decodeText(payload, fields);
+    }
+
+    // 订阅端日志用，解不出来就原样返回
+    static std::string toText(const std::string &payload)
+    {
+        std::vector<FieldValue> fields;
+        if (!decode(payload, fields))
+            return payload;
+        std::string out;
+        for (size_t i = 0; i < fields.size(); ++i)
+        {
+            if (i)
+                out += ", ";
+            out += fields[i].name + ": " + std::to_string(fields[i].value);
+        }
+        return out;
+    }
+
+    static bool toWeather(const std::vector<FieldValue> &fields, WeatherData &wd)
+    {
+        const auto &map = weatherRegisterMap();
+        uint8_t *image = reinterpret_cast<uint8_t *>(&wd);
+        memset(&wd, 0, sizeof(wd));
+        size_t found = 0;
+        for (const auto &f : map.fields)
+        {
+            for (const auto &v : fields)
+            {
+                if (v.name != f.name)
+                    continue;
+                if (f.type == RegType::F32)
+                    writeF32(image, f.reg, static_cast<float>(v.value));
+                else
+                    writeU16(image, f.reg, static_cast<uint16_t>(v.value));
+                ++found;
+                break;
+            }
+        }
+        return found == map.fields.size();
+    }
+
+private:
+    static float readF32(const uint8_t *image, uint16_t reg)
+    {
+        float v;
+        memcpy(&v, image + reg * 2, sizeof(v));
+        return v;
+    }
+    static uint16_t readU16(const uint8_t *image, uint16_t reg)
+    {
+        uint16_t v;
+        memcpy(&v, image + reg * 2, sizeof(v));
+        return v;
+    }
+    static void writeF32(uint8_t *image, uint16_t reg, float v) { memcpy(image + reg * 2, &v, sizeof(v)); }
+    static void writeU16(uint8_t *image, uint16_t reg, uint16_t v) { memcpy(image + reg * 2, &v, sizeof(v)); }
+
+    static bool decodePacked(const uint8_t *p, size_t len, std::vector<FieldValue> &fields)
+    {
+        if (len < 2)
+            return false;
+        const RegisterMap *map = findRegisterMap(p[1]);
+        if (!map || len - 2 < static_cast<size_t>(map->regCount()) * 2)
+            return false;
+        const uint8_t *image = p + 2;
+        for (const auto &f : map->fields)
+        {
+            double v = f.type == RegType::F32 ? readF32(image, f.reg) : readU16(image, f.reg);
+            fields.push_back({f.name, v});
+        }
+        return true;
+    }
+
+    static bool decodeCbor(const uint8_t *p, size_t len, std::vector<FieldValue> &fields)
+    {
+        CborReader r(p, len);
+        uint64_t n;
+        if (!r.container(5, n))
+            return false;
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            FieldValue fv;
+            if (!r.text(fv.name) || !r.number(fv.value))
+                return false;
+            fields.push_back(fv);
+        }
+        return true;
+    }
+
+    // "name: value, name: value"，兼容旧格式里不规则的空格
+    static bool decodeText(const std::string &s, std::vector<FieldValue> &fields)
+    {
+        size_t pos = 0;
+        while (pos < s.size())
+        {
+            size_t comma = s.find(',', pos);
+            if (comma == std::string::npos)
+                comma = s.size();
+            size_t colon = s.find(':', pos);
+            if (colon == std::string::npos || colon > comma)
+                return false;
+            size_t b = s.find_first_not_of(' ', pos);
+            size_t e = s.find_last_not_of(' ', colon - 1);
+            if (b == std::string::npos || e == std::string::npos || b > e)
+                return false;
+            FieldValue fv;
+            fv.name = s.substr(b, e - b + 1);
+            const char *begin = s.c_str() + colon + 1;
+            char *endp = nullptr;
+            fv.value = strtod(begin, &endp);
+            if (endp == begin)
+                return false;
+            fields.push_back(fv);
+            pos = comma + 1;
+        }
+        return !fields.empty();
+    }
+};
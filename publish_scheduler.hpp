@@ -0,0 +1,216 @@
+#pragma once
+// publish_scheduler.hpp
+// 上行发布的优先级通道：告警 > 实时 > 补传 > 诊断，每个通道一个令牌桶限速，
+// 低优先级排队太久时插队一次，防止饿死
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+
+enum class Lane : uint8_t
+{
+    ALARM,
+    LIVE,
+    BACKLOG,
+    DIAG
+};
+const size_t LANE_COUNT = 4;
+
+inline const char *laneToString(Lane lane)
+{
+    static const char *names[] = {"ALARM", "LIVE", "BACKLOG", "DIAG"};
+    return names[static_cast<size_t>(lane)];
+}
+
+// 字节/秒令牌桶，rate 为 0 表示不限速
+class TokenBucket
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    TokenBucket(double rate = 0, double burst = 0) { configure(rate, burst); }
+
+    void configure(double rate, double burst)
+    {
+        rate_ = rate;
+        burst_ = std::max(burst, rate);
+        tokens_ = burst_;
+        last_ = clock::now();
+    }
+
+    bool unlimited() const { return rate_ <= 0; }
+
+    // 令牌够就扣掉；一条消息比桶还大时等桶满了放行，避免永远发不出去
+    bool consume(size_t bytes, clock::time_point now)
+    {
+        if (unlimited())
+            return true;
+        refill(now);
+        double need = std::min(static_cast<double>(bytes), burst_);
+        if (tokens_ < need)
+            return false;
+        tokens_ -= static_cast<double>(bytes);
+        return true;
+    }
+
+    // 还要等多久才够 bytes 个令牌
+    clock::duration waitFor(size_t bytes, clock::time_point now)
+    {
+        if (unlimited())
+            return clock::duration::zero();
+        refill(now);
+        double need = std::min(static_cast<double>(bytes), burst_) - tokens_;
+        if (need <= 0)
+            return clock::duration::zero();
+        return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(need / rate_));
+    }
+
+private:
+    void refill(clock::time_point now)
+    {
+        double elapsed = std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+    }
+
+    double rate_ = 0;
+    double burst_ = 0;
+    double tokens_ = 0;
+    clock::time_point last_;
+};
+
+template <typename T>
+class LaneScheduler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @param capacity     每个通道最多排队的条数，超出丢最旧的
+     * @param starve_after 低优先级通道队首等待超过这个时间就优先发一条
+     */
+    explicit LaneScheduler(size_t capacity = 1000,
+                           clock::duration starve_after = std::chrono::seconds(10))
+        : capacity_(capacity), starve_after_(starve_after) {}
+
+    void setRate(Lane lane, double bytes_per_sec, double burst = 0)
+    {
+        lanes_[index(lane)].bucket.configure(bytes_per_sec, burst);
+    }
+
+    // 返回 false 表示挤掉了一条最旧的
+    bool push(Lane lane, T item, size_t bytes)
+    {
+        auto &l = lanes_[index(lane)];
+        bool ok = true;
+        if (l.queue.size() >= capacity_)
+        {
+            l.queue.pop_front();
+            ++l.dropped;
+            ok = false;
+        }
+        l.queue.push_back({std::move(item), bytes, clock::now()});
+        return ok;
+    }
+
+    // 断线重发的消息放回通道最前面
+    void pushFront(Lane lane, T item, size_t bytes)
+    {
+        auto &l = lanes_[index(lane)];
+        l.queue.push_front({std::move(item), bytes, clock::now()});
+        if (l.queue.size() > capacity_)
+        {
+            l.queue.pop_back();
+            ++l.dropped;
+        }
+    }
+
+    /**
+     * @brief 取下一条可以发送的消息
+     * @param wait 没有可发的时，返回最早能发的等待时间（都空时为 max）
+     */
+    bool pop(T &item, clock::duration &wait)
+    {
+        auto now = clock::now();
+        wait = clock::duration::max();
+
+        // 告警永远最先
+        if (take(0, now, item, wait))
+            return true;
+
+        // 饿死保护：其余通道里排得最久且超时的队首先走
+        int starving = -1;
+        for (size_t i = 1; i < LANE_COUNT; ++i)
+        {
+            auto &l = lanes_[i];
+            if (!l.queue.empty() && now - l.queue.front().enqueued >= starve_after_ &&
+                (starving < 0 || l.queue.front().enqueued < lanes_[starving].queue.front().enqueued))
+                starving = static_cast<int>(i);
+        }
+        if (starving >= 0 && take(static_cast<size_t>(starving), now, item, wait))
+            return true;
+
+        for (size_t i = 1; i < LANE_COUNT; ++i)
+        {
+            if (take(i, now, item, wait))
+                return true;
+        }
+        return false;
+    }
+
+    bool empty() const
+    {
+        for (const auto &l : lanes_)
+        {
+            if (!l.queue.empty())
+                return false;
+        }
+        return true;
+    }
+    size_t size(Lane lane) const { return lanes_[index(lane)].queue.size(); }
+    size_t size() const
+    {
+        size_t n = 0;
+        for (const auto &l : lanes_)
+            n += l.queue.size();
+        return n;
+    }
+    size_t dropped(Lane lane) const { return lanes_[index(lane)].dropped; }
+
+private:
+    struct Entry
+    {
+        T item;
+        size_t bytes;
+        clock::time_point enqueued;
+    };
+    struct LaneState
+    {
+        std::deque<Entry> queue;
+        TokenBucket bucket;
+        size_t dropped = 0;
+    };
+
+    static size_t index(Lane lane) { return static_cast<size_t>(lane); }
+
+    bool take(size_t i, clock::time_point now, T &item, clock::duration &wait)
+    {
+        auto &l = lanes_[i];
+        if (l.queue.empty())
+            return false;
+        auto &front = l.queue.front();
+        if (!l.bucket.consume(front.bytes, now))
+        {
+            wait = std::min(wait, l.bucket.waitFor(front.bytes, now));
+            return false;
+        }
+        item = std::move(front.item);
+        l.queue.pop_front();
+        return true;
+    }
+
+    size_t capacity_;
+    clock::duration starve_after_;
+    LaneState lanes_[LANE_COUNT];
+};
@@ -1,66 +1,57 @@
 #pragma once
 
 #include <mqtt/async_client.h>
+#include <memory>
 #include <string>
 #include <iostream>
 #include "ElegantLog.hpp"
+#include "mqtt_connection.hpp"
 
 class Publisher
 {
 
 private:
-    std::string SERVER_ADDRESS;
-    std::string CLIENT_ID;
     std::string TOPIC;
 
-    mqtt::async_client client;
+    std::shared_ptr<MqttConnection> conn;
 
 public:
-    Publisher(std::string server="broker.emqx.io:1883",std::string client_id="cpp_publisher",std::string topic="yun/topic") :SERVER_ADDRESS(server),
-                                    CLIENT_ID(client_id),TOPIC(topic),client(SERVER_ADDRESS, CLIENT_ID) {
-                                        connect();
+    // 挂到共享连接上，连接由调用方负责 connect()
+    Publisher(std::shared_ptr<MqttConnection> connection, std::string topic = "yun/topic") : TOPIC(topic), conn(connection) {}
+
+    // 独占一条连接（旧用法）；v5=true 时使用 MQTT v5：会话过期代替 clean_session，热点主题走主题别名
+    Publisher(std::string server="broker.emqx.io:1883",std::string client_id="cpp_publisher",std::string topic="yun/topic",bool v5=false) :TOPIC(topic),
+                                    conn(std::make_shared<MqttConnection>(server, client_id, v5)) {
+                                        conn->connect();
                                     }
-    ~Publisher() {
-        disconnect();
-    }
+
     void connect()
     {
-        mqtt::connect_options connOpts;
-        connOpts.set_keep_alive_interval(20);
-        connOpts.set_clean_session(true);
-
-        try
-        {
-            client.connect(connOpts)->wait();
-            LOG_INFO("Connected to EMQX broker");
-        }
-        catch (const mqtt::exception &exc)
-        {
-            LOG_ERROR("Error: {}", exc.what());
-            throw;
-        }
+        conn->connect();
     }
 
     void publish(const std::string &payload)
     {
-        mqtt::message_ptr pubmsg = mqtt::make_message(TOPIC, payload, 1, false);
-        client.publish(pubmsg)->wait();
-        
-        LOG_INFO("Message published: {}", payload);
+        publish(payload, TOPIC);
     }
 
-    void publish(const std::string &payload,const std::string topic,int qos=1, bool retained=false)
+    void publish(const std::string &payload, Lane lane)
     {
-        mqtt::message_ptr pubmsg = mqtt::make_message(topic, payload, qos, retained);
-        client.publish(pubmsg)->wait();
-        LOG_INFO("Message published: {}", payload);
+        publish(payload, TOPIC, 1, false, lane);
+    }
+
+    // 断线时不抛异常，消息由连接暂存，重连后补发；lane 决定发送优先级
+    void publish(const std::string &payload,const std::string topic,int qos=1, bool retained=false, Lane lane=Lane::LIVE)
+    {
+        if (conn->publish(topic, payload, qos, retained, lane))
+            LOG_INFO("Message published: {}", payload);
+        else
+            LOG_WARN("Broker offline, message held for resend ({} held)", conn->heldMessages());
     }
 
     void disconnect()
     {
-        client.disconnect()->wait();
-        LOG_INFO("Disconnected from EMQX broker");
+        conn->disconnect();
     }
 };
 
-
@@ -13,7 +13,12 @@
 #include <thread>
 #include <mutex>
 #include <iostream>
+#include <future>
+#include <atomic>
+#include <condition_variable>
+#include <poll.h>
 #include "frame_comm.hpp"
+#include "modbus_scheduler.hpp"
 #include "ElegantLog.hpp"
 template <typename T>
 class ringbuff
@@ -97,22 +102,8 @@ private:
     std::mutex mutex_;
 };
 
-class meteserial
+class meteserial : public modbus::Master
 {
-#pragma pack(push, 1)
-    struct metemodbus
-    {
-        uint8_t sysaddr = 0x00; // 系统地址
-        uint8_t fun = 0x03;
-        uint8_t regaddr_h = 0x00;
-        uint8_t regaddr_l;
-        uint8_t regcnt_h = 0x00;
-        uint8_t regcnt_l;
-        uint16_t crc16;
-    };
-
-#pragma pack(pop)
-
 private:
     meteserial(std::string com = "/dev/ttysWK2", int baud_rate = 9600, int bits = 8,
                std::string parity = "n", int stop_bits = 1)
@@ -124,11 +115,11 @@ private:
         config.parity = parity;
         config.stop_bits = stop_bits;
 
-        data.regaddr_l = 0x00;
-        data.regcnt_l = 0x08;
-        tx_cmd = (uint8_t *)&data;
-        tx_len = sizeof(data);
-        data.crc16 = modbus_crc16(tx_cmd, tx_len - 2);
+        // 倾角传感器：系统地址 0，从 0 开始 8 个保持寄存器（x/y/z/t 四个 float）
+        sensor_req.slave = 0x00;
+        sensor_req.function = modbus::READ_HOLDING_REGISTERS;
+        sensor_req.address = 0x0000;
+        sensor_req.count = 8;
     }
 
 public:
@@ -144,6 +135,7 @@ public:
         if (work_.joinable())
         {
             running = false;
+            sched_.stop();
             work_.join();
         }
         // 1. 关闭文件描述符（如果有效）
@@ -158,14 +150,12 @@ public:
 private:
     int fd;
     int n = 0;
-    int cnt = 0;
     SerialConfig config;
-    metemodbus data;
-    uint8_t *tx_cmd;
-    size_t tx_len;
-    uint8_t rx_buf[128] = {0};
+    modbus::Request sensor_req;
+    uint8_t rx_buf[256] = {0}; // RTU 帧最长 256 字节
     ringbuff<std::vector<uint8_t>> buff{30};
     std::mutex mutex_;
+    std::condition_variable data_cv_;
     std::atomic<bool> running{true};
     std::thread work_;
 
@@ -187,96 +177,157 @@ public:
             exit(EXIT_FAILURE);
         }
         running = true;
+        sched_.addPoll(sensor_req, std::chrono::seconds(5), [this](const modbus::Response &rsp)
+                       { onSensorData(rsp); });
         work_ = std::thread(&meteserial::fromreg, this);
 
     }
 
+    // 串口线程：逐个执行调度器给出的事务
     void fromreg()
     {
-        while (running)
+        modbus::Transaction t;
+        while (running && sched_.next(t))
         {
+            execute(t.request, t.done);
+            // 帧间至少 3.5 个字符的静默时间
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
 
+private:
+    void onSensorData(const modbus::Response &rsp)
+    {
+        if (rsp.status != modbus::Status::OK)
+            return;
+        // 按线上的字节顺序存，getFloatData 直接按字节拷成 float
+        std::vector<uint8_t> tempdata;
+        for (uint16_t r : rsp.registers)
+        {
+            tempdata.push_back(static_cast<uint8_t>(r >> 8));
+            tempdata.push_back(static_cast<uint8_t>(r & 0xFF));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buff.push(tempdata);
+        }
+        data_cv_.notify_all();
+    }
+
+    void execute(const modbus::Request &req, const modbus::Callback &done)
+    {
+        auto tx = modbus::rtuFrame(req);
+        int got = exchange(tx.data(), tx.size(), modbus::rtuResponseLength(req));
+        modbus::Response rsp;
+        if (got > 0)
+            modbus::decodeRtu(req, rx_buf, got, rsp);
+        // 成功的事务轮询加快时最多每秒一条；失败（超时、CRC、异常应答）每次都记，RPC 和网关的错误不能被限流吞掉
+        if (rsp.status == modbus::Status::OK)
+            LOG_INFO_RATE(1, "Modbus slave {} fc {} addr {}: {}", static_cast<int>(req.slave), static_cast<int>(req.function),
+                          req.address, modbus::statusToString(rsp.status));
+        else
+            LOG_WARN("Modbus slave {} fc {} addr {}: {}", static_cast<int>(req.slave), static_cast<int>(req.function),
+                     req.address, modbus::statusToString(rsp.status));
+        if (done)
+            done(rsp);
+    }
+
+    /**
+     * @brief 发一帧并收应答到 rx_buf
+     * 收满 expect 字节或收到异常应答（5 字节）即返回；每次等待最多 1.5s
+     * @return 收到的字节数，0 表示超时
+     */
+    int exchange(const uint8_t *tx, size_t len, size_t expect)
+    {
+        // 先清掉上一帧残留，再发命令
+        if (tcflush(fd, TCIFLUSH) == -1)
+        {
+            LOG_ERROR("Failed to flush read buffer: {}{}", config.com, strerror(errno));
+            close(fd);
+            exit(-1);
+        }
+        size_t sent = 0;
+        while (sent < len)
+        {
+            n = write(fd, tx + sent, len - sent);
+            if (n < 0)
+            {
+                LOG_ERROR("Failed to write to serial port: {}{}", config.com, strerror(errno));
+                close(fd);
+                exit(-1);
+            }
+            else if (n == 0)
             {
-                std::lock_guard<std::mutex> lock(mutex_);
-                n = 0;
-                cnt = 0;
-                memset(rx_buf, 0, sizeof(rx_buf));
-                // 发送命令
-                while (1)
-                {
-                    n = write(fd, tx_cmd + cnt, sizeof(data) - cnt);
-                    if (n < 0)
-                    {
-                        LOG_ERROR("Failed to write to serial port: {}{}", config.com, strerror(errno));
-                        close(fd);
-                        exit(-1);
-                    }
-                    else if (n == 0)
-                    {
-                        break;
-                    }
-                    cnt += n;
-                }
-                LOG_INFO("Sent {} bytes to serial port: {}", cnt, config.com);
-                LOG_INFO("{}", ElegantLog::formathex(tx_cmd, tx_len));
-                // 清空读串口缓冲区
-                if (tcflush(fd, TCIFLUSH) == -1)
-                {
-                    LOG_ERROR("Failed to flush read buffer: {}{}", config.com, strerror(errno));
-                    close(fd);
-                    exit(-1);
-                    // 错误处理
-                }
-                n = 0;
-                cnt = 0;
-                while (1)
-                {
-                    n = read(fd, rx_buf + cnt, sizeof(rx_buf));
-                    if (n < 0)
-                    {
-                        LOG_ERROR("Failed to read from serial port: {}{}", config.com, strerror(errno));
-                        close(fd);
-                        exit(-1);
-                    }
-                    else if (n == 0)
-                    {
-                        LOG_WARN("Timeout reached when reading from serial port: {}", config.com);
-                        break;
-                    }
-                    cnt += n;
-                    if (cnt == 5 + data.regcnt_l * 2)
-                    {
-                        break;
-                    }
-                }
-                if (0x0000 == modbus_crc16(rx_buf, 5 + data.regcnt_l * 2))
-                {
-                    // 打印接收到的原始数据
-                    LOG_INFO("Received {} bytes from serial port: {}", cnt, config.com);
-
-                    LOG_INFO("{}", ElegantLog::formathex(rx_buf, 5 + data.regcnt_l * 2));
-
-                    std::vector<uint8_t> tempdata(rx_buf + 3, rx_buf + 3 + data.regcnt_l * 2);
-                    buff.push(tempdata);
-                }
+                break;
             }
-            std::this_thread::sleep_for(std::chrono::seconds(5)); // 简单休眠
+            sent += n;
         }
+        // 字节数和报文放在一条里，限流时不会配错事务
+        LOG_INFO_RATE(1, "Sent {} bytes to serial port: {} {}", sent, config.com, ElegantLog::formathex(tx, len));
 
-
+        memset(rx_buf, 0, sizeof(rx_buf));
+        expect = std::min(expect, sizeof(rx_buf));
+        size_t got = 0;
+        while (got < expect)
+        {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (::poll(&pfd, 1, 1500) <= 0)
+            {
+                LOG_WARN("Timeout reached when reading from serial port: {}", config.com);
+                break;
+            }
+            n = read(fd, rx_buf + got, expect - got);
+            if (n < 0)
+            {
+                LOG_ERROR("Failed to read from serial port: {}{}", config.com, strerror(errno));
+                close(fd);
+                exit(-1);
+            }
+            else if (n == 0)
+            {
+                LOG_WARN("Timeout reached when reading from serial port: {}", config.com);
+                break;
+            }
+            got += n;
+            if (got == 5 && modbus::rtuIsException(rx_buf, got))
+                break;
+        }
+        if (got > 0)
+        {
+            // 打印接收到的原始数据
+            LOG_INFO_RATE(1, "Received {} bytes from serial port: {} {}", got, config.com, ElegantLog::formathex(rx_buf, got));
+        }
+        return static_cast<int>(got);
     }
 
 public:
+    // 等待第一帧有效数据，超时返回 false
+    template <typename Rep, typename Period>
+    bool waitForData(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return data_cv_.wait_for(lock, timeout, [this]
+                                 { return buff.size() > 0; });
+    }
+
+    bool hasData()
+    {
+        return buff.size() > 0;
+    }
 
     std::vector<float> getFloatData(){
         std::lock_guard<std::mutex> lock(mutex_);
+        if (buff.size() == 0)
+        {
+            return std::vector<float>(4, 0.0f);
+        }
         auto &lastData = buff.back();
         std::vector<float> floatValue(4);
         memcpy(floatValue.data(), lastData.data(), 4*sizeof(float)); // 避免类型双关（type-punning）问题
-        LOG_INFO("x_Float Value: {}", floatValue[0]);
-        LOG_INFO("y_Float Value: {}", floatValue[1]);
-        LOG_INFO("z_Float Value: {}", floatValue[2]);
-        LOG_INFO("t_Float Value: {}", floatValue[3]);
+        LOG_INFO_RATE(1, "x_Float Value: {}", floatValue[0]);
+        LOG_INFO_RATE(1, "y_Float Value: {}", floatValue[1]);
+        LOG_INFO_RATE(1, "z_Float Value: {}", floatValue[2]);
+        LOG_INFO_RATE(1, "t_Float Value: {}", floatValue[3]);
 
         return floatValue;
     }
@@ -1,79 +1,157 @@
 #pragma once
 #include <mqtt/async_client.h>
+#include <atomic>
+#include <memory>
 #include <string>
-#include <iostream>
+#include <vector>
+#include <future>
 #include "ElegantLog.hpp"
-class callback : public virtual mqtt::callback
-{
-    void message_arrived(mqtt::const_message_ptr msg) override
-    {
-        LOG_INFO("Message arrived: {}", msg->get_payload_str());
-    }
-};
+#include "dispatch_pool.hpp"
+#include "mqtt_connection.hpp"
+#include "payload_codec.hpp"
+#include "tsz_codec.hpp"
 
 class Subscriber
 {
 private:
-    std::string SERVER_ADDRESS;
-    std::string CLIENT_ID;
     std::string TOPIC;
 
-    mqtt::async_client client;
-    callback cb;
+    std::shared_ptr<MqttConnection> conn;
+    std::vector<int> handler_ids;
+    // paho 回调线程只负责入队，解码和用户逻辑在池里跑；析构时先摘掉回调再等池排空
+    DispatchPool pool;
+    std::atomic<size_t> dropped_warned{0}; // 上次告警时的丢弃数
 
 public:
-    Subscriber(std::string server = "broker.emqx.io:1883", std::string client_id = "cpp_publisher", std::string topic = "yun/topic") : SERVER_ADDRESS(server),
-                                                                                                                                       CLIENT_ID(client_id), TOPIC(topic), client(SERVER_ADDRESS, CLIENT_ID)
+    // 挂到共享连接上，连接由调用方负责 connect()
+    // policy：分发队列满时的处理，默认丢最旧的；BLOCK 会卡住 paho 回调线程，所有订阅和发布确认都跟着停
+    Subscriber(std::shared_ptr<MqttConnection> connection, std::string topic = "yun/topic",
+               OverflowPolicy policy = OverflowPolicy::DROP_OLDEST)
+        : TOPIC(topic), conn(connection), pool(4, 256, policy)
     {
-        client.set_callback(cb);
+        attach();
+    }
+
+    // 独占一条连接（旧用法）；v5=true 时使用 MQTT v5 会话过期，重连后 broker 保留订阅和未收的 QoS1 消息
+    Subscriber(std::string server = "broker.emqx.io:1883", std::string client_id = "cpp_publisher", std::string topic = "yun/topic", bool v5 = false,
+               OverflowPolicy policy = OverflowPolicy::DROP_OLDEST)
+        : TOPIC(topic), conn(std::make_shared<MqttConnection>(server, client_id, v5)), pool(4, 256, policy)
+    {
+        attach();
         connect();
     }
-    ~Subscriber(){
-        disconnect();
+    ~Subscriber()
+    {
+        for (int id : handler_ids)
+            conn->removeMessageHandler(id);
     };
     int connect()
     {
-        mqtt::connect_options connOpts;
-        connOpts.set_keep_alive_interval(20);
-        connOpts.set_clean_session(true);
-
         try
         {
-            // Connect to EMQX broker
-            client.connect(connOpts)->wait();
-            LOG_INFO("Connected to EMQX broker");
-
+            conn->connect();
         }
-        catch (const mqtt::exception &exc)
+        catch (const mqtt::exception &)
         {
-            LOG_ERROR("Error: {}", exc.what());
             return 1;
         }
         return -1;
     }
 
-    void subtopic()
+    // 都不阻塞：未连接时只登记，连接建立后由连接统一发出订阅
+    std::future<bool> subtopic()
     {
-        // Subscribe to topic
-        client.subscribe(TOPIC, 1)->wait();
-        LOG_INFO("Subscribed to topic: {}", TOPIC);
-
+        return subtopic(TOPIC);
     }
-    void subtopic(std::string topic, int qos=1)
+    std::future<bool> subtopic(const std::string &topic, int qos = 1)
     {
-        // Subscribe to topic
-        client.subscribe(topic, qos)->wait();
-        LOG_INFO("Subscribed to topic: {}", topic);
+        return subtopics({topic}, qos);
+    }
 
-        // Keep running to receive messages
-        LOG_INFO("Press Enter to exit...");
-        std::cin.get();
+    /**
+     * @brief 多个主题过滤器合并成一个 SUBSCRIBE 包订阅
+     * @param done 完成回调（在 paho 线程里调用），全部订阅成功为 true
+     */
+    std::future<bool> subtopics(const std::vector<std::string> &filters, int qos = 1,
+                                MqttConnection::subscribe_callback done = nullptr)
+    {
+        std::vector<std::pair<std::string, int>> subs;
+        for (const auto &f : filters)
+            subs.emplace_back(f, qos);
+        return conn->subscribeMany(subs, std::move(done));
     }
 
     void disconnect()
     {
-        client.disconnect()->wait();
-        LOG_INFO("Disconnected from EMQX broker");
+        conn->disconnect();
+    }
+
+    DispatchStats dispatchStats() { return pool.stats(); }
+
+    /**
+     * @brief 给一个主题过滤器（可带 + / #）挂处理函数并订阅
+     * 处理函数在分发线程池里执行，同一主题的消息按到达顺序处理
+     * @return 句柄，过滤器不合法时返回 0
+     */
+    int on(const std::string &filter, MqttConnection::message_handler handler, int qos = 1)
+    {
+        int id = route(filter, std::move(handler));
+        if (id != 0)
+            conn->subscribe(filter, qos);
+        return id;
+    }
+
+private:
+    void attach()
+    {
+        route(TOPIC, [this](mqtt::const_message_ptr msg)
+              { message_arrived(msg); });
+    }
+
+    // paho 回调线程只做入队
+    int route(const std::string &filter, MqttConnection::message_handler handler)
+    {
+        auto h = std::make_shared<MqttConnection::message_handler>(std::move(handler));
+        int id = conn->addMessageHandler(filter, [this, h](mqtt::const_message_ptr msg)
+                                         {
+            pool.submit(msg->get_topic(), [h, msg]
+                        { (*h)(msg); });
+            // 丢新的、丢旧的都算；第一次丢和之后每多丢 100 条报一次
+            size_t dropped = pool.dropped();
+            size_t warned = dropped_warned.load(std::memory_order_relaxed);
+            if (dropped != 0 && (warned == 0 || dropped >= warned + 100) &&
+                dropped_warned.compare_exchange_strong(warned, dropped))
+            {
+                auto st = pool.stats();
+                LOG_WARN("Dispatch queue full, dropped {} messages (depth {}, high water {})", st.dropped, st.depth, st.high_water);
+            } });
+        if (id == 0)
+            LOG_ERROR("Invalid topic filter: {}", filter);
+        else
+            handler_ids.push_back(id);
+        return id;
+    }
+
+    void message_arrived(mqtt::const_message_ptr msg)
+    {
+        const std::string &payload = msg->get_payload_str();
+        if (TszDecoder::isBlock(payload))
+        {
+            TszDecoder dec(payload);
+            int64_t ts;
+            std::vector<float> v;
+            while (dec.next(ts, v))
+            {
+                std::string text;
+                for (size_t i = 0; i < v.size(); ++i)
+                {
+                    text += (i ? ", " : "") + std::to_string(v[i]);
+                }
+                LOG_INFO("Message arrived: [{}] {}", ts, text);
+            }
+            return;
+        }
+        LOG_INFO("Message arrived: {}", PayloadCodec::toText(payload));
     }
 };
 
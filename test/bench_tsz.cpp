@@ -0,0 +1,124 @@
+// 批量压缩的压缩率/吞吐测试
+// 用法：bench_tsz [trace.csv] [每块样本数]
+// trace.csv 每行 "毫秒时间戳,x,y,z,t"；不给文件时生成一段模拟的传感器数据
+#include <bits/stdc++.h>
+#include "../tsz_codec.hpp"
+#include "../payload_codec.hpp"
+
+struct Sample
+{
+    int64_t ts;
+    float v[4];
+};
+
+static std::vector<Sample> loadTrace(const char *path)
+{
+    std::vector<Sample> out;
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line))
+    {
+        Sample s;
+        long long ts;
+        if (sscanf(line.c_str(), "%lld,%f,%f,%f,%f", &ts, &s.v[0], &s.v[1], &s.v[2], &s.v[3]) == 5)
+        {
+            s.ts = ts;
+            out.push_back(s);
+        }
+    }
+    return out;
+}
+
+// 倾角 x/y/z 慢漂移 + 量化噪声，温度按 0.01 分辨率，5s 采样带几毫秒抖动
+static std::vector<Sample> synthTrace(size_t n)
+{
+    std::vector<Sample> out(n);
+    std::mt19937 rng(42);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::uniform_int_distribution<int> jitter(-3, 3);
+    int64_t ts = 1700000000000LL;
+    float base[4] = {1.25f, -0.75f, 89.5f, 25.0f};
+    const float step[4] = {0.001f, 0.001f, 0.001f, 0.01f};
+    for (size_t i = 0; i < n; ++i)
+    {
+        ts += 5000 + jitter(rng);
+        out[i].ts = ts;
+        for (int c = 0; c < 4; ++c)
+        {
+            base[c] += noise(rng) * step[c] * 0.2f;
+            float q = std::round((base[c] + noise(rng) * step[c]) / step[c]) * step[c];
+            out[i].v[c] = q;
+        }
+    }
+    return out;
+}
+
+int main(int argc, char const *argv[])
+{
+    std::vector<Sample> trace = argc > 1 ? loadTrace(argv[1]) : synthTrace(200000);
+    size_t block = argc > 2 ? std::stoul(argv[2]) : 60;
+    if (trace.empty() || block == 0)
+    {
+        std::cerr << "empty trace" << std::endl;
+        return 1;
+    }
+
+    size_t textBytes = 0, cborBytes = 0;
+    for (const auto &s : trace)
+    {
+        std::vector<float> v(s.v, s.v + 4);
+        textBytes += PayloadCodec::encodeSample(v, PayloadFormat::TEXT).size() + 20; // + 时间戳
+        cborBytes += PayloadCodec::encodeSample(v, PayloadFormat::CBOR).size() + 9;
+    }
+    size_t rawBytes = trace.size() * (8 + 4 * sizeof(float));
+
+    std::vector<std::string> blocks;
+    TszEncoder enc(4);
+    auto t0 = std::chrono::steady_clock::now();
+    for (const auto &s : trace)
+    {
+        enc.append(s.ts, s.v);
+        if (enc.count() >= block)
+            blocks.push_back(enc.finish());
+    }
+    if (enc.count())
+        blocks.push_back(enc.finish());
+    auto t1 = std::chrono::steady_clock::now();
+
+    size_t tszBytes = 0, decoded = 0;
+    int64_t ts;
+    float v[4];
+    for (const auto &b : blocks)
+    {
+        tszBytes += b.size();
+        TszDecoder dec(b);
+        while (dec.next(ts, v))
+        {
+            const Sample &s = trace[decoded];
+            if (ts != s.ts || memcmp(v, s.v, sizeof(v)) != 0)
+            {
+                std::cerr << "mismatch at sample " << decoded << std::endl;
+                return 1;
+            }
+            ++decoded;
+        }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    if (decoded != trace.size())
+    {
+        std::cerr << "decoded " << decoded << " of " << trace.size() << std::endl;
+        return 1;
+    }
+
+    double encSec = std::chrono::duration<double>(t1 - t0).count();
+    double decSec = std::chrono::duration<double>(t2 - t1).count();
+    printf("samples          : %zu (block %zu)\n", trace.size(), block);
+    printf("raw   bytes/sample: %.2f\n", double(rawBytes) / trace.size());
+    printf("text  bytes/sample: %.2f\n", double(textBytes) / trace.size());
+    printf("cbor  bytes/sample: %.2f\n", double(cborBytes) / trace.size());
+    printf("tsz   bytes/sample: %.2f  (raw x%.2f, text x%.2f)\n", double(tszBytes) / trace.size(),
+           double(rawBytes) / tszBytes, double(textBytes) / tszBytes);
+    printf("encode: %.2f Msamples/s   decode: %.2f Msamples/s\n",
+           trace.size() / encSec / 1e6, trace.size() / decSec / 1e6);
+    return 0;
+}
@@ -0,0 +1,135 @@
+// 二进制日志解码：把 BinaryFileSink 写的文件转成和 FileSink 一样的文本
+// 用法: log_decode myapp.blog [更多文件...]；轮转下来的 myapp.blog.N.gz 先 gunzip，每个文件都能单独解码
+#include <bits/stdc++.h>
+#include "../ElegantLog.hpp"
+
+struct Site
+{
+    int level;
+    std::string location;
+    std::string func;
+    std::string fmt;
+};
+
+class Reader
+{
+public:
+    explicit Reader(FILE *f) : f_(f) {}
+
+    template <typename T>
+    bool get(T &v) { return fread(&v, sizeof(v), 1, f_) == 1; }
+
+    bool getString(std::string &s)
+    {
+        uint16_t n;
+        if (!get(n))
+            return false;
+        s.resize(n);
+        return n == 0 || fread(&s[0], 1, n, f_) == n;
+    }
+
+private:
+    FILE *f_;
+};
+
+static const char *levelName(int level)
+{
+    static const char *levels[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+    return level >= 0 && level < 6 ? levels[level] : "UNKNOWN";
+}
+
+static std::string formatTime(int64_t ns)
+{
+    time_t sec = static_cast<time_t>(ns / 1000000000);
+    std::tm tm;
+    localtime_r(&sec, &tm);
+    char buf[64];
+    size_t n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(buf + n, sizeof(buf) - n, ".%06d", static_cast<int>(ns % 1000000000 / 1000));
+    return buf;
+}
+
+static bool decode(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    char magic[4];
+    uint8_t version;
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, ElegantLog::binary::MAGIC, 4) != 0 ||
+        fread(&version, 1, 1, f) != 1 || version != ElegantLog::binary::VERSION)
+    {
+        fprintf(stderr, "%s: not an ElegantLog binary file\n", path);
+        fclose(f);
+        return false;
+    }
+
+    Reader in(f);
+    std::map<uint32_t, Site> sites;
+    std::string text, args;
+    int type;
+    bool ok = true;
+    while ((type = fgetc(f)) != EOF)
+    {
+        if (type == 'S')
+        {
+            uint32_t id;
+            uint8_t level;
+            Site site;
+            if (!in.get(id) || !in.get(level) || !in.getString(site.location) || !in.getString(site.func) ||
+                !in.getString(site.fmt))
+                break;
+            site.level = level;
+            sites[id] = site;
+        }
+        else if (type == 'R')
+        {
+            uint32_t id;
+            int64_t time;
+            if (!in.get(id) || !in.get(time) || !in.getString(args))
+                break;
+            auto it = sites.find(id);
+            if (it == sites.end())
+            {
+                fprintf(stderr, "%s: record for unknown site %u\n", path, id);
+                continue;
+            }
+            text.clear();
+            ElegantLog::formatEncoded(text, it->second.fmt.c_str(), args.data(), args.size());
+            printf("%s [%s] [%s] [%s][%s] %s\n", formatTime(time).c_str(), levelName(it->second.level),
+                   levelName(it->second.level), it->second.location.c_str(), it->second.func.c_str(), text.c_str());
+        }
+        else if (type == 'T')
+        {
+            uint8_t level;
+            int64_t time;
+            if (!in.get(level) || !in.get(time) || !in.getString(text))
+                break;
+            printf("%s [%s] %s\n", formatTime(time).c_str(), levelName(level), text.c_str());
+        }
+        else
+        {
+            fprintf(stderr, "%s: corrupt entry type 0x%02x\n", path, type);
+            ok = false;
+            break;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s FILE...\n", argv[0]);
+        return 2;
+    }
+    bool ok = true;
+    for (int i = 1; i < argc; ++i)
+        ok = decode(argv[i]) && ok;
+    return ok ? 0 : 1;
+}
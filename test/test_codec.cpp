@@ -0,0 +1,50 @@
+#include <bits/stdc++.h>
+#include "../payload_codec.hpp"
+
+int main()
+{
+    std::vector<float> sample = {1.234567f, -2.5f, 30.125f, 28.9188f};
+    const char *names[] = {"text", "cbor", "packed"};
+    PayloadFormat fmts[] = {PayloadFormat::TEXT, PayloadFormat::CBOR, PayloadFormat::PACKED};
+    for (int i = 0; i < 3; ++i)
+    {
+        std::string payload = PayloadCodec::encodeSample(sample, fmts[i]);
+        std::vector<FieldValue> fields;
+        assert(PayloadCodec::decode(payload, fields));
+        assert(fields.size() == 4);
+        for (size_t k = 0; k < fields.size(); ++k)
+            assert(std::fabs(fields[k].value - sample[k]) < 1e-5);
+        std::cout << names[i] << ": " << payload.size() << " bytes -> "
+                  << PayloadCodec::toText(payload) << std::endl;
+    }
+
+    // 文本格式和旧版逐字节一致
+    assert(PayloadCodec::encodeSample({1.0f, 2.0f, 3.0f, 4.0f}, PayloadFormat::TEXT) ==
+           "x: 1.000000,y: 2.000000, z: 3.000000, t: 4.000000");
+
+    // 旧格式的文本也要能解
+    std::vector<FieldValue> legacy;
+    assert(PayloadCodec::decode("x: 1.000000,y: 2.000000, z: 3.000000, t: 4.000000", legacy));
+    assert(legacy.size() == 4 && legacy[1].name == "y" && legacy[3].value == 4.0);
+
+    WeatherData wd;
+    memset(&wd, 0, sizeof(wd));
+    wd.avgWindSpeed10min = 3.4f;
+    wd.avgWindDir10min = 270;
+    wd.airTemperature = -5.5f;
+    wd.humidity = 87;
+    wd.airPressure = 1013.2f;
+    wd.radiationIntensity = 640;
+    for (int i = 0; i < 3; ++i)
+    {
+        std::string payload = PayloadCodec::encodeWeather(wd, fmts[i]);
+        std::vector<FieldValue> fields;
+        WeatherData out;
+        assert(PayloadCodec::decode(payload, fields));
+        assert(PayloadCodec::toWeather(fields, out));
+        assert(out.avgWindDir10min == 270 && out.humidity == 87 && out.radiationIntensity == 640);
+        assert(std::fabs(out.airPressure - 1013.2f) < 1e-2);
+        std::cout << "weather " << names[i] << ": " << payload.size() << " bytes" << std::endl;
+    }
+    return 0;
+}
@@ -13,8 +13,30 @@ int main() {
     
     // 测试日志写入
     for (int i = 0; i < 10; ++i) {
-        LOG_INFO("This is log message , testing file rotation", i);
+        LOG_INFO("This is log message {}, testing file rotation", i);
     }
+
+    // 热路径限流：每 4 次一条、每秒最多 2 条；连续相同的消息折叠
+    ElegantLog::Logger::instance().setRepeatWindow(std::chrono::seconds(30));
+    for (int i = 0; i < 10; ++i) {
+        LOG_INFO_EVERY(4, "every 4th call: {}", i);
+        LOG_INFO_RATE(2, "rate limited: {}", i);
+        LOG_WARN("serial port timeout");
+    }
+
+    // 只有本线程打过日志时可以换队列，别的线程写过之后拒绝
+    assert(ElegantLog::Logger::instance().setQueue(64, ElegantLog::OverflowPolicy::BLOCK));
+    std::promise<void> logged, finish;
+    std::thread worker([&] {
+        LOG_INFO("from worker thread");
+        logged.set_value();
+        finish.get_future().wait();
+    });
+    logged.get_future().wait();
+    assert(!ElegantLog::Logger::instance().setQueue(128, ElegantLog::OverflowPolicy::BLOCK));
+    finish.set_value();
+    worker.join();
+    LOG_INFO("done");
     
     return 0;
 }
@@ -0,0 +1,218 @@
+// Modbus TCP 主站测试：本地起一个简易从站，一次收齐一批请求后倒序应答，
+// 验证流水线下按事务号匹配、读写、异常码和超时
+#include <bits/stdc++.h>
+#include <poll.h>
+#include "../modbus_tcp.hpp"
+
+class StandInServer
+{
+public:
+    StandInServer() : regs(100, 0), coils(64, 0)
+    {
+        for (size_t i = 0; i < regs.size(); ++i)
+            regs[i] = static_cast<uint16_t>(1000 + i);
+        lfd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(lfd, (sockaddr *)&addr, sizeof(addr));
+        listen(lfd, 1);
+        socklen_t len = sizeof(addr);
+        getsockname(lfd, (sockaddr *)&addr, &len);
+        port = ntohs(addr.sin_port);
+        worker = std::thread(&StandInServer::serve, this);
+    }
+    ~StandInServer()
+    {
+        shutdown(lfd, SHUT_RDWR);
+        close(lfd);
+        if (cfd >= 0)
+            shutdown(cfd, SHUT_RDWR);
+        worker.join();
+    }
+
+    uint16_t port;
+    std::vector<uint16_t> regs;
+    std::vector<uint8_t> coils;
+    std::atomic<size_t> max_batch{0};
+    std::atomic<bool> mute{false}; // 不应答，用来测超时
+
+private:
+    void serve()
+    {
+        // 客户端 stop() 后再 start() 会重新连上来
+        while ((cfd = accept(lfd, nullptr, nullptr)) >= 0)
+            session();
+    }
+
+    void session()
+    {
+        std::vector<uint8_t> in;
+        uint8_t buf[1024];
+        while (true)
+        {
+            ssize_t n = recv(cfd, buf, sizeof(buf), 0);
+            if (n <= 0)
+                break;
+            in.insert(in.end(), buf, buf + n);
+            // 再等一下，让客户端把流水线里的请求都发过来
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            pollfd pfd = {cfd, POLLIN, 0};
+            while (poll(&pfd, 1, 0) > 0 && (n = recv(cfd, buf, sizeof(buf), 0)) > 0)
+                in.insert(in.end(), buf, buf + n);
+
+            std::vector<std::vector<uint8_t>> replies;
+            size_t len;
+            while ((len = modbus::tcpFrameLength(in.data(), in.size())) != 0)
+            {
+                replies.push_back(handle(in.data(), len));
+                in.erase(in.begin(), in.begin() + len);
+            }
+            max_batch = std::max<size_t>(max_batch, replies.size());
+            if (mute)
+                continue;
+            for (auto it = replies.rbegin(); it != replies.rend(); ++it)
+                send(cfd, it->data(), it->size(), MSG_NOSIGNAL);
+        }
+        close(cfd);
+        cfd = -1;
+    }
+
+    std::vector<uint8_t> handle(const uint8_t *f, size_t len)
+    {
+        std::vector<uint8_t> pdu;
+        uint8_t fc = f[7];
+        uint16_t addr = modbus::getU16(f + 8);
+        uint16_t cnt = modbus::getU16(f + 10);
+        pdu.push_back(fc);
+        switch (fc)
+        {
+        case modbus::READ_HOLDING_REGISTERS:
+            if (addr + cnt > regs.size())
+                return reply(f, {static_cast<uint8_t>(fc | 0x80), 0x02});
+            pdu.push_back(static_cast<uint8_t>(cnt * 2));
+            for (uint16_t i = 0; i < cnt; ++i)
+                modbus::putU16(pdu, regs[addr + i]);
+            break;
+        case modbus::WRITE_SINGLE_REGISTER:
+            regs[addr] = cnt;
+            pdu.assign(f + 7, f + len);
+            break;
+        case modbus::WRITE_MULTIPLE_REGISTERS:
+            for (uint16_t i = 0; i < cnt; ++i)
+                regs[addr + i] = modbus::getU16(f + 13 + i * 2);
+            pdu.assign(f + 7, f + 12);
+            break;
+        case modbus::READ_COILS:
+            pdu.push_back(static_cast<uint8_t>((cnt + 7) / 8));
+            pdu.resize(2 + (cnt + 7) / 8, 0);
+            for (uint16_t i = 0; i < cnt; ++i)
+                if (coils[addr + i])
+                    pdu[2 + i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+            break;
+        case modbus::WRITE_SINGLE_COIL:
+            coils[addr] = cnt == 0xFF00;
+            pdu.assign(f + 7, f + len);
+            break;
+        default:
+            return reply(f, {static_cast<uint8_t>(fc | 0x80), 0x01});
+        }
+        return reply(f, pdu);
+    }
+
+    static std::vector<uint8_t> reply(const uint8_t *req, const std::vector<uint8_t> &pdu)
+    {
+        std::vector<uint8_t> out(req, req + 4);
+        modbus::putU16(out, static_cast<uint16_t>(pdu.size() + 1));
+        out.push_back(req[6]);
+        out.insert(out.end(), pdu.begin(), pdu.end());
+        return out;
+    }
+
+    int lfd = -1;
+    int cfd = -1;
+    std::thread worker;
+};
+
+static modbus::Request readRegs(uint16_t addr, uint16_t count)
+{
+    modbus::Request r;
+    r.slave = 1;
+    r.function = modbus::READ_HOLDING_REGISTERS;
+    r.address = addr;
+    r.count = count;
+    return r;
+}
+
+int main()
+{
+    StandInServer server;
+    ModbusTcpClient client("127.0.0.1", server.port, 8, std::chrono::milliseconds(300));
+    client.start();
+
+    // 8 个并发读，服务端倒序应答
+    std::vector<std::future<modbus::Response>> reads;
+    for (uint16_t i = 0; i < 8; ++i)
+        reads.push_back(client.submit(readRegs(i * 10, 4)));
+    for (uint16_t i = 0; i < 8; ++i)
+    {
+        modbus::Response rsp = reads[i].get();
+        assert(rsp.status == modbus::Status::OK && rsp.registers.size() == 4);
+        assert(rsp.registers[0] == 1000 + i * 10 && rsp.registers[3] == 1003 + i * 10);
+    }
+    std::cout << "pipelined requests per batch: " << server.max_batch << std::endl;
+    assert(server.max_batch > 1);
+
+    // 写后读
+    modbus::Request w;
+    w.slave = 1;
+    w.function = modbus::WRITE_MULTIPLE_REGISTERS;
+    w.address = 5;
+    w.values = {7, 8, 9};
+    assert(client.submit(w).get().status == modbus::Status::OK);
+    modbus::Response rsp = client.submit(readRegs(5, 3)).get();
+    assert((rsp.registers == std::vector<uint16_t>{7, 8, 9}));
+
+    modbus::Request coil;
+    coil.slave = 1;
+    coil.function = modbus::WRITE_SINGLE_COIL;
+    coil.address = 3;
+    coil.values = {1};
+    assert(client.submit(coil).get().status == modbus::Status::OK);
+    coil.function = modbus::READ_COILS;
+    coil.address = 0;
+    coil.count = 5;
+    coil.values.clear();
+    rsp = client.submit(coil).get();
+    assert((rsp.registers == std::vector<uint16_t>{0, 0, 0, 1, 0}));
+
+    // 越界地址返回异常码 2
+    rsp = client.submit(readRegs(98, 4)).get();
+    assert(rsp.status == modbus::Status::EXCEPTION && rsp.exception == 2);
+
+    // 轮询
+    std::atomic<int> polls{0};
+    client.addPoll(readRegs(0, 1), std::chrono::milliseconds(50), [&polls](const modbus::Response &r)
+                   { if (r.status == modbus::Status::OK) ++polls; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    assert(polls >= 3);
+
+    // 从站不应答时按超时结束
+    server.mute = true;
+    rsp = client.submit(readRegs(0, 1)).get();
+    assert(rsp.status == modbus::Status::TIMEOUT);
+
+    // stop 之后还能再 start
+    client.stop();
+    server.mute = false;
+    client.start();
+    rsp = client.submit(readRegs(5, 3)).get();
+    assert(rsp.status == modbus::Status::OK && (rsp.registers == std::vector<uint16_t>{7, 8, 9}));
+
+    client.stop();
+    std::cout << "modbus tcp ok" << std::endl;
+    return 0;
+}
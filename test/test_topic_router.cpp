@@ -0,0 +1,57 @@
+#include <bits/stdc++.h>
+#include "../topic_router.hpp"
+
+static std::vector<int> hits(TopicRouter<int> &r, const std::string &topic)
+{
+    std::vector<int> out;
+    r.match(topic, out);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+int main()
+{
+    TopicRouter<int> r;
+    int a = r.add("dev/+/cmd", 1);
+    r.add("dev/#", 2);
+    r.add("dev/42/cmd", 3);
+    r.add("#", 4);
+    r.add("+/+", 5);
+    assert(r.add("dev/#/x", 9) == 0 && r.add("dev/a+", 9) == 0);
+
+    assert((hits(r, "dev/42/cmd") == std::vector<int>{1, 2, 3, 4}));
+    assert((hits(r, "dev/7/cmd") == std::vector<int>{1, 2, 4}));
+    assert((hits(r, "dev") == std::vector<int>{2, 4}));
+    assert((hits(r, "dev/7") == std::vector<int>{2, 4, 5}));
+    assert((hits(r, "$SYS/broker") == std::vector<int>{}));
+
+    assert(r.remove(a) && !r.remove(a));
+    assert((hits(r, "dev/7/cmd") == std::vector<int>{2, 4}));
+
+    // 和逐条匹配的结果一致
+    const char *filters[] = {"a/b", "a/+", "+/b", "a/#", "+/+/c", "#", "a/b/c", "x"};
+    const char *topics[] = {"a", "a/b", "a/b/c", "x", "x/b", "a//c", "$a/b"};
+    TopicRouter<int> all;
+    for (int i = 0; i < 8; ++i)
+        all.add(filters[i], i);
+    for (const char *t : topics)
+    {
+        std::vector<int> expect;
+        for (int i = 0; i < 8; ++i)
+            if (topicMatches(filters[i], t))
+                expect.push_back(i);
+        assert(hits(all, t) == expect);
+    }
+
+    // 几百个过滤器时的匹配耗时
+    TopicRouter<int> big;
+    for (int i = 0; i < 500; ++i)
+        big.add("site/dev" + std::to_string(i) + "/cmd/+", i);
+    std::vector<int> out;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100000; ++i)
+        big.match("site/dev" + std::to_string(i % 500) + "/cmd/reset", out);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / 100000;
+    std::cout << "500 filters: " << us << " us/match" << std::endl;
+    return 0;
+}
@@ -0,0 +1,198 @@
+#pragma once
+// topic_router.hpp
+// 按主题过滤器分发消息的前缀树：每层主题一个节点，+ 和 # 也是普通子节点，
+// 匹配时只沿主题层级往下走，耗时和过滤器数量无关
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 按 '/' 切分主题层级，"a//b" 中间是空层
+inline void splitTopic(const std::string &topic, std::vector<std::string> &levels)
+{
+    levels.clear();
+    size_t start = 0;
+    while (true)
+    {
+        size_t end = topic.find('/', start);
+        if (end == std::string::npos)
+        {
+            levels.emplace_back(topic, start);
+            return;
+        }
+        levels.emplace_back(topic, start, end - start);
+        start = end + 1;
+    }
+}
+
+// 过滤器合法性：# 只能是最后一层，+ 和 # 必须独占一层
+inline bool validTopicFilter(const std::string &filter)
+{
+    if (filter.empty())
+        return false;
+    std::vector<std::string> levels;
+    splitTopic(filter, levels);
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        const std::string &l = levels[i];
+        if (l == "#")
+        {
+            if (i + 1 != levels.size())
+                return false;
+        }
+        else if (l != "+" && l.find_first_of("+#") != std::string::npos)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 单个过滤器匹配，支持 + 和 #；以 $ 开头的系统主题不被首层通配符匹配
+inline bool topicMatches(const std::string &filter, const std::string &topic)
+{
+    std::vector<std::string> f, t;
+    splitTopic(filter, f);
+    splitTopic(topic, t);
+    if (!topic.empty() && topic[0] == '$' && (f[0] == "+" || f[0] == "#"))
+        return false;
+    size_t i = 0;
+    for (; i < f.size(); ++i)
+    {
+        if (f[i] == "#")
+            return true;
+        if (i >= t.size() || (f[i] != "+" && f[i] != t[i]))
+            return false;
+    }
+    return i == t.size();
+}
+
+template <typename Handler>
+class TopicRouter
+{
+public:
+    /**
+     * @brief 注册一个过滤器的处理函数
+     * @return 句柄，用于 remove；过滤器不合法时返回 0
+     */
+    int add(const std::string &filter, Handler handler)
+    {
+        if (!validTopicFilter(filter))
+            return 0;
+        std::vector<std::string> levels;
+        splitTopic(filter, levels);
+        std::lock_guard<std::mutex> lock(mutex_);
+        Node *node = &root_;
+        for (const auto &l : levels)
+        {
+            auto &child = node->children[l];
+            if (!child)
+                child.reset(new Node());
+            node = child.get();
+        }
+        int id = ++next_id_;
+        node->handlers.emplace_back(id, std::move(handler));
+        filters_[id] = filter;
+        return id;
+    }
+
+    bool remove(int id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = filters_.find(id);
+        if (it == filters_.end())
+            return false;
+        std::vector<std::string> levels;
+        splitTopic(it->second, levels);
+        filters_.erase(it);
+        erase(root_, levels, 0, id);
+        return true;
+    }
+
+    // 取出所有匹配 topic 的处理函数（拷贝出来，调用时不持锁）
+    void match(const std::string &topic, std::vector<Handler> &out)
+    {
+        out.clear();
+        std::vector<std::string> levels;
+        splitTopic(topic, levels);
+        bool system = !topic.empty() && topic[0] == '$';
+        std::lock_guard<std::mutex> lock(mutex_);
+        collect(root_, levels, 0, system, out);
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return filters_.size();
+    }
+
+private:
+    struct Node
+    {
+        std::unordered_map<std::string, std::unique_ptr<Node>> children;
+        std::vector<std::pair<int, Handler>> handlers;
+    };
+
+    static void append(const Node &node, std::vector<Handler> &out)
+    {
+        for (const auto &h : node.handlers)
+            out.push_back(h.second);
+    }
+
+    void collect(const Node &node, const std::vector<std::string> &levels, size_t depth, bool system,
+                 std::vector<Handler> &out)
+    {
+        // "a/#" 也匹配 "a" 本身
+        bool wild = !(system && depth == 0);
+        if (wild)
+        {
+            auto hash = node.children.find("#");
+            if (hash != node.children.end())
+                append(*hash->second, out);
+        }
+        if (depth == levels.size())
+        {
+            append(node, out);
+            return;
+        }
+        auto exact = node.children.find(levels[depth]);
+        if (exact != node.children.end())
+            collect(*exact->second, levels, depth + 1, system, out);
+        if (wild)
+        {
+            auto plus = node.children.find("+");
+            if (plus != node.children.end())
+                collect(*plus->second, levels, depth + 1, system, out);
+        }
+    }
+
+    // 删掉处理函数，顺带回收空节点；返回该节点是否已经空了
+    bool erase(Node &node, const std::vector<std::string> &levels, size_t depth, int id)
+    {
+        if (depth == levels.size())
+        {
+            for (auto it = node.handlers.begin(); it != node.handlers.end(); ++it)
+            {
+                if (it->first == id)
+                {
+                    node.handlers.erase(it);
+                    break;
+                }
+            }
+        }
+        else
+        {
+            auto it = node.children.find(levels[depth]);
+            if (it != node.children.end() && erase(*it->second, levels, depth + 1, id))
+                node.children.erase(it);
+        }
+        return node.handlers.empty() && node.children.empty();
+    }
+
+    Node root_;
+    std::unordered_map<int, std::string> filters_;
+    int next_id_ = 0;
+    std::mutex mutex_;
+};
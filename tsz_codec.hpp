@@ -0,0 +1,398 @@
+#pragma once
+// tsz_codec.hpp
+// 批量时序数据压缩（参考 Facebook Gorilla）：
+//   时间戳做二阶差分(delta-of-delta)，浮点值与同通道上一个值做 XOR
+// 块格式：0xFE | 版本 | 通道数 | 样本数(u16 BE) | 首个时间戳(i64 BE, ms) | 比特流
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::string &out) : out_(out) {}
+
+    // 写入 v 的低 n 位（n <= 64），高位在前
+    void write(uint64_t v, int n)
+    {
+        while (n > 0)
+        {
+            if (free_ == 0)
+            {
+                out_.push_back(0);
+                free_ = 8;
+            }
+            int take = n < free_ ? n : free_;
+            uint8_t bits = static_cast<uint8_t>((v >> (n - take)) & ((1u << take) - 1));
+            out_.back() = static_cast<char>(static_cast<uint8_t>(out_.back()) | (bits << (free_ - take)));
+            free_ -= take;
+            n -= take;
+        }
+    }
+    void bit(bool b) { write(b ? 1 : 0, 1); }
+    void reset() { free_ = 0; }
+
+private:
+    std::string &out_;
+    int free_ = 0; // 最后一个字节剩余的位数
+};
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t *data, size_t len) : p_(data), end_(data + len) {}
+
+    bool read(uint64_t &v, int n)
+    {
+        v = 0;
+        while (n > 0)
+        {
+            if (p_ == end_)
+                return false;
+            int avail = 8 - used_;
+            int take = n < avail ? n : avail;
+            uint8_t bits = static_cast<uint8_t>((*p_ >> (avail - take)) & ((1u << take) - 1));
+            v = (v << take) | bits;
+            used_ += take;
+            n -= take;
+            if (used_ == 8)
+            {
+                ++p_;
+                used_ = 0;
+            }
+        }
+        return true;
+    }
+    bool bit(bool &b)
+    {
+        uint64_t v;
+        if (!read(v, 1))
+            return false;
+        b = v != 0;
+        return true;
+    }
+
+private:
+    const uint8_t *p_;
+    const uint8_t *end_;
+    int used_ = 0;
+};
+
+namespace tsz
+{
+    const uint8_t MAGIC = 0xFE;
+    const uint8_t VERSION = 1;
+    const size_t HEADER_SIZE = 13;
+    const size_t MAX_SAMPLES = 0xFFFF;
+
+    inline int clz32(uint32_t v) { return v ? __builtin_clz(v) : 32; }
+    inline int ctz32(uint32_t v) { return v ? __builtin_ctz(v) : 32; }
+}
+
+class TszEncoder
+{
+public:
+    explicit TszEncoder(int channels = 4) : channels_(channels), prev_(channels), leading_(channels), trailing_(channels), bits_(out_)
+    {
+        reset();
+    }
+    // bits_ 引用了 out_，不能拷贝
+    TszEncoder(const TszEncoder &) = delete;
+    TszEncoder &operator=(const TszEncoder &) = delete;
+
+    int channels() const { return channels_; }
+    size_t count() const { return count_; }
+    size_t size() const { return out_.size(); }
+    bool full() const { return count_ >= tsz::MAX_SAMPLES; }
+
+    void reset()
+    {
+        out_.assign(tsz::HEADER_SIZE, 0);
+        out_[0] = static_cast<char>(tsz::MAGIC);
+        out_[1] = static_cast<char>(tsz::VERSION);
+        out_[2] = static_cast<char>(channels_);
+        bits_.reset();
+        count_ = 0;
+        prevTs_ = 0;
+        prevDelta_ = 0;
+    }
+
+    // ts 为毫秒时间戳，values 至少 channels() 个
+    bool append(int64_t ts, const float *values)
+    {
+        if (full())
+            return false;
+        if (count_ == 0)
+        {
+            for (int i = 0; i < 8; ++i)
+                out_[5 + i] = static_cast<char>((static_cast<uint64_t>(ts) >> (56 - i * 8)) & 0xFF);
+            for (int c = 0; c < channels_; ++c)
+            {
+                memcpy(&prev_[c], &values[c], sizeof(uint32_t));
+                bits_.write(prev_[c], 32);
+                leading_[c] = 0xFF; // 还没有可复用的有效位窗口
+                trailing_[c] = 0;
+            }
+        }
+        else
+        {
+            int64_t delta = ts - prevTs_;
+            writeTimestamp(delta - prevDelta_);
+            prevDelta_ = delta;
+            for (int c = 0; c < channels_; ++c)
+            {
+                uint32_t v;
+                memcpy(&v, &values[c], sizeof(v));
+                writeValue(c, v);
+            }
+        }
+        prevTs_ = ts;
+        ++count_;
+        out_[3] = static_cast<char>(count_ >> 8);
+        out_[4] = static_cast<char>(count_ & 0xFF);
+        return true;
+    }
+
+    bool append(int64_t ts, const std::vector<float> &values) { return append(ts, values.data()); }
+
+    // 取走当前块并重新开始
+    std::string finish()
+    {
+        std::string block;
+        block.swap(out_);
+        reset();
+        return block;
+    }
+
+private:
+    // 二阶差分分桶：0 | 10+7位 | 110+9位 | 1110+12位 | 1111+32位
+    void writeTimestamp(int64_t dod)
+    {
+        if (dod == 0)
+        {
+            bits_.write(0, 1);
+        }
+        else if (dod >= -63 && dod <= 64)
+        {
+            bits_.write(0x2, 2);
+            bits_.write(static_cast<uint64_t>(dod + 63), 7);
+        }
+        else if (dod >= -255 && dod <= 256)
+        {
+            bits_.write(0x6, 3);
+            bits_.write(static_cast<uint64_t>(dod + 255), 9);
+        }
+        else if (dod >= -2047 && dod <= 2048)
+        {
+            bits_.write(0xE, 4);
+            bits_.write(static_cast<uint64_t>(dod + 2047), 12);
+        }
+        else
+        {
+            bits_.write(0xF, 4);
+            bits_.write(static_cast<uint32_t>(static_cast<int32_t>(dod)), 32);
+        }
+    }
+
+    // XOR 编码：0 相同 | 10 复用上次窗口 | 11+5位前导零+5位(有效位数-1)
+    void writeValue(int c, uint32_t v)
+    {
+        uint32_t x = v ^ prev_[c];
+        prev_[c] = v;
+        if (x == 0)
+        {
+            bits_.write(0, 1);
+            return;
+        }
+        int lead = tsz::clz32(x);
+        int trail = tsz::ctz32(x);
+        if (leading_[c] != 0xFF && lead >= leading_[c] && trail >= trailing_[c])
+        {
+            bits_.write(0x2, 2);
+            int len = 32 - leading_[c] - trailing_[c];
+            bits_.write(x >> trailing_[c], len);
+            return;
+        }
+        int len = 32 - lead - trail;
+        bits_.write(0x3, 2);
+        bits_.write(static_cast<uint64_t>(lead), 5);
+        bits_.write(static_cast<uint64_t>(len - 1), 5);
+        bits_.write(x >> trail, len);
+        leading_[c] = static_cast<uint8_t>(lead);
+        trailing_[c] = static_cast<uint8_t>(trail);
+    }
+
+    int channels_;
+    std::vector<uint32_t> prev_;
+    std::vector<uint8_t> leading_;
+    std::vector<uint8_t> trailing_;
+    std::string out_;
+    BitWriter bits_;
+    size_t count_ = 0;
+    int64_t prevTs_ = 0;
+    int64_t prevDelta_ = 0;
+};
+
+// 流式解码：next() 每次吐出一个样本，不需要先展开整个块
+class TszDecoder
+{
+public:
+    TszDecoder(const uint8_t *data, size_t len)
+        : bits_(data + (len < tsz::HEADER_SIZE ? len : tsz::HEADER_SIZE),
+                len < tsz::HEADER_SIZE ? 0 : len - tsz::HEADER_SIZE)
+    {
+        valid_ = isBlock(data, len);
+        if (!valid_)
+            return;
+        channels_ = data[2];
+        total_ = (static_cast<size_t>(data[3]) << 8) | data[4];
+        uint64_t ts = 0;
+        for (int i = 0; i < 8; ++i)
+            ts = (ts << 8) | data[5 + i];
+        ts_ = static_cast<int64_t>(ts);
+        prev_.assign(channels_, 0);
+        leading_.assign(channels_, 0);
+        trailing_.assign(channels_, 0);
+    }
+    explicit TszDecoder(const std::string &block)
+        : TszDecoder(reinterpret_cast<const uint8_t *>(block.data()), block.size()) {}
+
+    static bool isBlock(const uint8_t *data, size_t len)
+    {
+        return len >= tsz::HEADER_SIZE && data[0] == tsz::MAGIC && data[1] == tsz::VERSION && data[2] > 0;
+    }
+    static bool isBlock(const std::string &payload)
+    {
+        return isBlock(reinterpret_cast<const uint8_t *>(payload.data()), payload.size());
+    }
+
+    bool valid() const { return valid_; }
+    int channels() const { return channels_; }
+    size_t count() const { return total_; }
+
+    // values 至少 channels() 个；块结束或数据损坏时返回 false
+    bool next(int64_t &ts, float *values)
+    {
+        if (!valid_ || read_ >= total_)
+            return false;
+        if (read_ == 0)
+        {
+            for (int c = 0; c < channels_; ++c)
+            {
+                uint64_t v;
+                if (!bits_.read(v, 32))
+                    return fail();
+                prev_[c] = static_cast<uint32_t>(v);
+            }
+        }
+        else
+        {
+            int64_t dod;
+            if (!readTimestamp(dod))
+                return fail();
+            delta_ += dod;
+            ts_ += delta_;
+            for (int c = 0; c < channels_; ++c)
+            {
+                if (!readValue(c))
+                    return fail();
+            }
+        }
+        for (int c = 0; c < channels_; ++c)
+            memcpy(&values[c], &prev_[c], sizeof(float));
+        ts = ts_;
+        ++read_;
+        return true;
+    }
+
+    bool next(int64_t &ts, std::vector<float> &values)
+    {
+        values.resize(channels_);
+        return next(ts, values.data());
+    }
+
+private:
+    bool fail()
+    {
+        valid_ = false;
+        return false;
+    }
+
+    bool readTimestamp(int64_t &dod)
+    {
+        int prefix = 0;
+        bool b;
+        while (prefix < 4)
+        {
+            if (!bits_.bit(b))
+                return false;
+            if (!b)
+                break;
+            ++prefix;
+        }
+        uint64_t v;
+        switch (prefix)
+        {
+        case 0:
+            dod = 0;
+            return true;
+        case 1:
+            if (!bits_.read(v, 7))
+                return false;
+            dod = static_cast<int64_t>(v) - 63;
+            return true;
+        case 2:
+            if (!bits_.read(v, 9))
+                return false;
+            dod = static_cast<int64_t>(v) - 255;
+            return true;
+        case 3:
+            if (!bits_.read(v, 12))
+                return false;
+            dod = static_cast<int64_t>(v) - 2047;
+            return true;
+        default:
+            if (!bits_.read(v, 32))
+                return false;
+            dod = static_cast<int32_t>(static_cast<uint32_t>(v));
+            return true;
+        }
+    }
+
+    bool readValue(int c)
+    {
+        bool b;
+        if (!bits_.bit(b))
+            return false;
+        if (!b)
+            return true; // 与上一个值相同
+        if (!bits_.bit(b))
+            return false;
+        uint64_t v;
+        if (b)
+        {
+            uint64_t lead, len;
+            if (!bits_.read(lead, 5) || !bits_.read(len, 5))
+                return false;
+            leading_[c] = static_cast<uint8_t>(lead);
+            trailing_[c] = static_cast<uint8_t>(32 - lead - (len + 1));
+        }
+        int len = 32 - leading_[c] - trailing_[c];
+        if (len <= 0 || !bits_.read(v, len))
+            return false;
+        prev_[c] ^= static_cast<uint32_t>(v) << trailing_[c];
+        return true;
+    }
+
+    BitReader bits_;
+    bool valid_ = false;
+    int channels_ = 0;
+    size_t total_ = 0;
+    size_t read_ = 0;
+    int64_t ts_ = 0;
+    int64_t delta_ = 0;
+    std::vector<uint32_t> prev_;
+    std::vector<uint8_t> leading_;
+    std::vector<uint8_t> trailing_;
+};